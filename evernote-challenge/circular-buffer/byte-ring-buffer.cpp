@@ -0,0 +1,126 @@
+// byte-ring-buffer.cpp: ByteRingCircularBuffer implementation (see byte-ring-buffer.h)
+#include "byte-ring-buffer.h"
+
+#include <algorithm>
+#include <cstring>     // memcpy
+
+#include "output-sink.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ByteRingCircularBuffer
+
+ByteRingCircularBuffer::ByteRingCircularBuffer( const size_t byteBudget ) :
+  m_maxSize( 0 ),
+  m_insertPoint( 0 ),
+  m_itemCount( 0 ),
+  m_headByte( 0 ),
+  m_liveBytes( 0 ),
+  m_bytes( byteBudget ),
+  m_lengths( 0 )
+{
+}
+
+void ByteRingCircularBuffer::setSize( const unsigned size )
+{
+  // same contract as SlotCircularBuffer: size is set once, before anything is appended.
+  m_maxSize = size;
+  m_lengths.resize( size );
+}
+
+size_t ByteRingCircularBuffer::oldestSlot( void ) const
+{
+  return m_insertPoint >= m_itemCount ? m_insertPoint - m_itemCount : m_insertPoint + m_maxSize - m_itemCount;
+}
+
+void ByteRingCircularBuffer::evictOldest( void )
+{
+  const size_t length = m_lengths[ oldestSlot() ];
+  m_headByte += length;
+  if( m_headByte >= m_bytes.size() )
+    m_headByte -= m_bytes.size();
+  m_liveBytes -= length;
+  m_itemCount--;
+}
+
+void ByteRingCircularBuffer::appendOne( const StringRef& entry )
+{
+  const size_t length = entry.length() + 1;
+  if( m_maxSize == 0 )
+  {
+    return;
+  }
+  if( length > m_bytes.size() )
+  {
+    // can never fit: it would evict everything older and still not fit, so the buffer just empties.
+    m_itemCount = 0;
+    m_liveBytes = 0;
+    return;
+  }
+
+  while( m_itemCount == m_maxSize || m_liveBytes + length > m_bytes.size() )
+  {
+    evictOldest();
+  }
+  if( m_itemCount == 0 )
+  {
+    m_headByte = 0;  // keeps the live range in one span whenever we get the chance.
+  }
+
+  // copy payload + newline, wrapping around the end of the ring at most once.
+  size_t tail = m_headByte + m_liveBytes;
+  if( tail >= m_bytes.size() )
+    tail -= m_bytes.size();
+  const size_t firstPart = std::min( entry.length(), m_bytes.size() - tail );
+  memcpy( &m_bytes[ tail ], entry.data(), firstPart );
+  memcpy( &m_bytes[ 0 ], entry.data() + firstPart, entry.length() - firstPart );
+  size_t newlinePos = tail + entry.length();
+  if( newlinePos >= m_bytes.size() )
+    newlinePos -= m_bytes.size();
+  m_bytes[ newlinePos ] = '\n';
+
+  m_liveBytes += length;
+  m_lengths[ m_insertPoint ] = length;
+  if( ++m_insertPoint == m_maxSize )
+    m_insertPoint = 0;
+  m_itemCount++;
+}
+
+void ByteRingCircularBuffer::append( const std::vector<StringRef>& list )
+{
+  for( std::vector<StringRef>::const_iterator i = list.begin(); i != list.end(); ++i )
+  {
+    appendOne( *i );
+  }
+}
+
+void ByteRingCircularBuffer::remove( const unsigned count )
+{
+  // the byte budget may already have evicted some of what the caller thinks is still here.
+  const unsigned removeCount = std::min( count, m_itemCount );
+  for( unsigned i = 0; i < removeCount; ++i )
+  {
+    evictOldest();
+  }
+}
+
+void ByteRingCircularBuffer::showList( void )
+{
+  if( m_liveBytes == 0 )
+  {
+    return;
+  }
+
+  struct iovec spans[ 2 ];
+  int spanCount = 1;
+  const size_t firstPart = std::min( m_liveBytes, m_bytes.size() - m_headByte );
+  spans[ 0 ].iov_base = &m_bytes[ m_headByte ];
+  spans[ 0 ].iov_len = firstPart;
+  if( firstPart < m_liveBytes )
+  {
+    spans[ 1 ].iov_base = &m_bytes[ 0 ];
+    spans[ 1 ].iov_len = m_liveBytes - firstPart;
+    spanCount = 2;
+  }
+
+  writeAllToStdout( spans, spanCount );
+}
@@ -0,0 +1,38 @@
+// byte-ring-buffer.h: CircularBuffer that copies entries into one preallocated byte ring.
+//  entry bytes are packed back to back, each followed by its '\n', so the live entries always
+//  occupy at most two contiguous spans of the ring and showList is a single writev. the length
+//  of each entry is kept in a parallel ring of N lengths, so eviction never has to scan bytes.
+//  the oldest entries are evicted when either N entries or the byte budget would be exceeded.
+#ifndef BYTE_RING_BUFFER_H
+#define BYTE_RING_BUFFER_H
+
+#include <vector>
+
+#include "circular-buffer.h"
+
+class ByteRingCircularBuffer : public CircularBuffer
+{
+  unsigned m_maxSize;       // N, the entry count limit
+  unsigned m_insertPoint;   // next slot in m_lengths
+  unsigned m_itemCount;
+
+  size_t   m_headByte;      // offset of the oldest live byte in m_bytes
+  size_t   m_liveBytes;     // bytes held by the live entries, newlines included
+
+  std::vector<char>   m_bytes;    // the ring itself, sized to the byte budget up front
+  std::vector<size_t> m_lengths;  // stored length (payload + '\n') of each entry, indexed like a slot buffer
+
+  size_t oldestSlot( void ) const;
+  void   evictOldest( void );
+  void   appendOne( const StringRef& entry );
+
+public:
+  ByteRingCircularBuffer( const size_t byteBudget );
+
+  void setSize( const unsigned size );
+  void append( const std::vector<StringRef>& list );
+  void remove( const unsigned count );
+  void showList( void );
+};
+
+#endif // BYTE_RING_BUFFER_H
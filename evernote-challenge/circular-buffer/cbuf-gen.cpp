@@ -0,0 +1,155 @@
+// cbuf-gen.cpp: generate cbuf inputs at the limits in prompt.txt (N <= 10000, <= 50000 commands,
+//  <= 20M characters of input) for benchmarking.
+//  usage: cbuf-gen <mixed|append|list|storm> [seed]
+//    mixed   N=10000, even mix of A/R/L
+//    append  N=10000, mostly appends, the odd R and L
+//    list    N=10000, mostly L against a full buffer
+//    storm   tiny N, huge appends that overwrite the buffer many times over
+//  output is deterministic for a given profile and seed.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>   // strtoul
+#include <stdint.h>
+
+static const unsigned kMaxCommands = 50000;
+static const size_t   kMaxChars    = 20000000;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Random: xorshift64*, so the same seed gives the same file everywhere.
+
+class Random
+{
+  uint64_t m_state;
+
+public:
+  Random( const uint64_t seed ) : m_state( seed * UINT64_C( 0x9E3779B97F4A7C15 ) + 1 ) {}
+
+  uint64_t next( void )
+  {
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+    return m_state * UINT64_C( 2685821657736338717 );
+  }
+
+  // uniform in [lo, hi]
+  unsigned range( const unsigned lo, const unsigned hi ) { return lo + next() % ( hi - lo + 1 ); }
+
+  bool chance( const unsigned percent ) { return next() % 100 < percent; }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Profile
+
+struct Profile
+{
+  const char* m_name;
+  unsigned    m_minSize;
+  unsigned    m_maxSize;
+  unsigned    m_appendPercent;
+  unsigned    m_removePercent;  // the rest are L
+  unsigned    m_longLinePercent;
+};
+
+static const Profile kProfiles[] =
+{
+  //  name      N range        A%  R%  long%
+  { "mixed",    10000, 10000,  40, 20,  5 },
+  { "append",   10000, 10000,  90,  5,  5 },
+  { "list",     10000, 10000,  10,  2,  5 },
+  { "storm",        1,    16,  70, 10,  1 },
+};
+
+// mostly short lines, some medium, the odd very long one.
+static unsigned lineLength( Random& rnd, const Profile& profile )
+{
+  if( rnd.chance( profile.m_longLinePercent ) )
+    return rnd.range( 200, 4000 );
+  if( rnd.chance( 30 ) )
+    return rnd.range( 17, 200 );
+  return rnd.range( 0, 16 );
+}
+
+static void appendLine( Random& rnd, const unsigned length, std::string& out )
+{
+  static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .,:;-_";
+  for( unsigned i = 0; i < length; ++i )
+    out += kAlphabet[ rnd.next() % ( sizeof( kAlphabet ) - 1 ) ];
+  out += '\n';
+}
+
+static void generate( const Profile& profile, Random& rnd, std::string& out )
+{
+  const unsigned size = rnd.range( profile.m_minSize, profile.m_maxSize );
+  out += std::to_string( size ) + "\n";
+
+  // spread the character budget over the appends we expect to issue, keeping enough back for
+  // the remaining commands themselves ("R 9999\n" at worst).
+  unsigned itemCount = 0;
+  for( unsigned command = 0; command < kMaxCommands - 1; ++command )
+  {
+    const unsigned commandsLeft = kMaxCommands - 1 - command;
+    const size_t reserved = out.size() + commandsLeft * 8 + 16;
+    const size_t charsLeft = kMaxChars - std::min( kMaxChars, reserved );
+    const size_t appendsLeft = std::max<size_t>( 1, commandsLeft * profile.m_appendPercent / 100 );
+    const unsigned meanLines = std::max<size_t>( 1, charsLeft / appendsLeft / 48 );
+    const unsigned roll = rnd.range( 0, 99 );
+
+    if( roll < profile.m_appendPercent && charsLeft > 0 )
+    {
+      const unsigned lineCount = rnd.range( 1, 2 * meanLines );
+      std::string lines;
+      unsigned written = 0;
+      for( ; written < lineCount; ++written )
+      {
+        const size_t before = lines.size();
+        appendLine( rnd, lineLength( rnd, profile ), lines );
+        if( lines.size() + 16 > charsLeft )
+        {
+          lines.resize( before );
+          break;
+        }
+      }
+      if( written == 0 )
+        continue;
+      out += "A " + std::to_string( written ) + "\n" + lines;
+      itemCount = std::min( itemCount + written, size );
+    }
+    else if( roll < profile.m_appendPercent + profile.m_removePercent )
+    {
+      // removes are sized like appends, so the buffer still fills up to N.
+      const unsigned removeCount = rnd.range( 0, std::min( itemCount, meanLines ) );
+      out += "R " + std::to_string( removeCount ) + "\n";
+      itemCount -= removeCount;
+    }
+    else
+    {
+      out += "L\n";
+    }
+  }
+  out += "Q\n";
+}
+
+int main( int argc, char **argv )
+{
+  const std::string name = argc > 1 ? argv[ 1 ] : "";
+  const uint64_t seed = argc > 2 ? strtoul( argv[ 2 ], 0, 10 ) : 1;
+
+  for( size_t i = 0; i < sizeof( kProfiles ) / sizeof( kProfiles[ 0 ] ); ++i )
+  {
+    if( name == kProfiles[ i ].m_name )
+    {
+      Random rnd( seed );
+      std::string out;
+      out.reserve( kMaxChars );
+      generate( kProfiles[ i ], rnd, out );
+      std::cout.write( out.data(), out.size() );
+      return 0;
+    }
+  }
+
+  std::cerr << "usage: cbuf-gen <mixed|append|list|storm> [seed]" << std::endl;
+  return 1;
+}
@@ -7,79 +7,22 @@
 #include <memory>
 #include <cctype>  // tolower
 #include <vector>
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// CircularBuffer
-
-class CircularBuffer
-{
-  unsigned m_maxSize;
-  unsigned m_insertPoint;
-  unsigned m_itemCount;
-
-  std::vector<std::string> m_buf;
-
-  int normalizeIndex( const int index ) const;
-
-public:
-  CircularBuffer() : m_maxSize( 0 ),
-                     m_insertPoint( 0 ),
-                     m_itemCount( 0 ),
-                     m_buf( 0 )
-  {
-  }
-
-  void setSize( const unsigned size );
-  void append( const std::list<std::string> list );
-  void remove( const unsigned count );
-  void showList( void );
-};
-
-int CircularBuffer::normalizeIndex( const int index ) const 
-{
-  int result = index;
-  while( result < 0 )
-    result += m_maxSize;
-  result %= m_maxSize;
-  return result;
-}
-
-void CircularBuffer::setSize( const unsigned size )
-{
-  m_maxSize = size;
-  m_buf.resize( size );
-  
-  // buffer state becomes undefined when size changes,
-  // this assumes that size will be set before anything
-  // is added to buffer (a valid assumption according to spec,
-  // since size always comes first).
-}
-
-void CircularBuffer::append( const std::list<std::string> list )
-{
-  // we want an ordered append so avoid for_each
-  for( std::list<std::string>::const_iterator i = list.begin(); i != list.end(); ++i )
-  {
-    m_buf[ m_insertPoint ] = *i;
-    m_insertPoint = normalizeIndex( m_insertPoint + 1 );
-    m_itemCount = std::min( m_itemCount + 1, m_maxSize );
-  }
-}
-
-void CircularBuffer::remove( const unsigned count )
-{
-  m_itemCount -= count;
-}
-
-void CircularBuffer::showList( void )
-{
-  for( int i = 0; i < m_itemCount; ++i )
-  {
-    int thisIndex = normalizeIndex( m_insertPoint - m_itemCount + i );
-    std::cout << m_buf[ thisIndex ] << std::endl;
-  }
-}
-
+#include <cstring>  // memchr
+#include <cstdlib>  // strtoul
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>  // getrusage
+
+#include "string-ref.h"
+#include "input-source.h"
+#include "input-release.h"
+#include "circular-buffer.h"
+#include "byte-ring-buffer.h"
+#include "persistent-circular-buffer.h"
+#include "spsc-circular-buffer.h"
+#include "content-index.h"
+#include "reader-cursor.h"
+#include "shard-service.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // CBufCommand and related
@@ -87,6 +30,8 @@ void CircularBuffer::showList( void )
 class CBufCommand
 {
 public:
+  virtual ~CBufCommand() {}
+
   virtual void perform( CircularBuffer& cb ) const = 0;
 };
 
@@ -109,14 +54,18 @@ void CBufSizeCommand::perform( CircularBuffer& cb ) const
 
 class CBufAppendCommand : public CBufCommand
 {
-  const std::list<std::string> m_appendList;
+  std::vector<StringRef> m_appendList;
+  const unsigned         m_skipCount;  // lines before m_appendList that it would overwrite
 public:
-  CBufAppendCommand( std::list<std::string> _appendList ) : m_appendList( _appendList ) {}
+  // takes over the contents of _appendList (leaving it empty) rather than copying it.
+  CBufAppendCommand( std::vector<StringRef>& _appendList, unsigned _skipCount ) : m_skipCount( _skipCount ) { m_appendList.swap( _appendList ); }
   void perform( CircularBuffer& cb ) const;
 };
 
 void CBufAppendCommand::perform( CircularBuffer& cb ) const
 {
+  if( m_skipCount > 0 )
+    cb.skip( m_skipCount );
   cb.append( m_appendList );
 }
 
@@ -151,6 +100,37 @@ void CBufListCommand::perform( CircularBuffer& cb ) const
 
 ///////////////
 
+class CBufFindCommand : public CBufCommand
+{
+  const StringRef m_content;
+public:
+  CBufFindCommand( const StringRef& _content ) : m_content( _content ) {}
+  void perform( CircularBuffer& cb ) const;
+};
+
+void CBufFindCommand::perform( CircularBuffer& cb ) const
+{
+  cb.showPositions( m_content );
+}
+
+///////////////
+
+class CBufNextCommand : public CBufCommand
+{
+  const unsigned m_cursor;
+  const unsigned m_count;
+public:
+  CBufNextCommand( unsigned _cursor, unsigned _count ) : m_cursor( _cursor ), m_count( _count ) {}
+  void perform( CircularBuffer& cb ) const;
+};
+
+void CBufNextCommand::perform( CircularBuffer& cb ) const
+{
+  cb.showNext( m_cursor, m_count );
+}
+
+///////////////
+
 class CBufQuitCommand : public CBufCommand
 {
 public:
@@ -181,65 +161,158 @@ void CBufCommandError::perform( CircularBuffer& cb ) const
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // InputParser
 
+enum CBufCommandType
+{
+  kCBufSize,
+  kCBufAppend,
+  kCBufRemove,
+  kCBufList,
+  kCBufFind,
+  kCBufNext,
+  kCBufQuit,
+  kCBufError,
+};
+
 class InputParser
 {
   bool            m_didReadSize;
-  std::istream&   m_istream;
+  const bool      m_fFindEnabled;  // accept "F <line>", only meaningful with an indexed buffer
+  const bool      m_fNextEnabled;  // accept "N <cursor> <count>", only meaningful with cursors
+  unsigned        m_capacity;  // N from the first line
+  LineReader      m_reader;
 
-  static unsigned readCountArg( const std::string& _str );
+  static unsigned readCountArg( const StringRef& _line );
 
-  const std::list<std::string> getAppendList( const unsigned numLines );
+  // returns how many lines it skipped.
+  unsigned getAppendList( const unsigned numLines, /*out*/ std::vector<StringRef>& appendList );
 
 public:
-  InputParser( std::istream& _istream ) :
-    m_istream( _istream ),
-    m_didReadSize( false )
+  InputParser( InputSource& _input, const bool _fFindEnabled, const bool _fNextEnabled ) :
+    m_didReadSize( false ),
+    m_fFindEnabled( _fFindEnabled ),
+    m_fNextEnabled( _fNextEnabled ),
+    m_capacity( 0 ),
+    m_reader( _input )
   { }
 
+  // parses one command without allocating it: the count for size/remove or the cursor to read
+  // goes in arg, the number of entries to read or of lines an append skipped goes in count. the
+  // lines that survive an append go in appendList, the line to look for in a find is the one
+  // entry of appendList.
+  CBufCommandType parseNextCommand( /*out*/ unsigned& arg, /*out*/ unsigned& count, /*out*/ std::vector<StringRef>& appendList );
+
+  // true if the next command's first line is already in, so parsing it won't wait for input.
+  bool lineBuffered( void ) const { return m_reader.lineBuffered(); }
+
   std::auto_ptr<const CBufCommand> getNextCommand( /*out*/ bool& fDone );
 };
 
-/*static*/ unsigned InputParser::readCountArg( const std::string& _str )
+// atoi on [p, end), returning where it stopped.
+static const char* parseUnsignedAt( const char* p, const char* end, /*out*/ unsigned& result )
+{
+  while( p != end && isspace( *p ) )
+    ++p;
+  result = 0;
+  for( ; p != end && isdigit( *p ); ++p )
+    result = result * 10 + ( *p - '0' );
+  return p;
+}
+
+// equivalent to atoi on the line after skipping the command char (so "A 12" -> 12, "10" -> 10 with skip == 0).
+static unsigned parseUnsigned( const StringRef& _line, const size_t skip )
+{
+  unsigned result;
+  parseUnsignedAt( _line.data() + std::min( skip, _line.length() ), _line.data() + _line.length(), result );
+  return result;
+}
+
+/*static*/ unsigned InputParser::readCountArg( const StringRef& _line )
 {
-  std::string trimmed = _str.substr( 2 );
-  return atoi( trimmed.c_str() );
+  return parseUnsigned( _line, 1 );
 }
 
-const std::list<std::string> InputParser::getAppendList( const unsigned numLines )
+unsigned InputParser::getAppendList( const unsigned numLines, /*out*/ std::vector<StringRef>& appendList )
 {
-  std::list<std::string> appendList;
-  for( int i = 0; i < numLines; ++i )
+  // only the last N lines of an append can survive it, everything before that would be
+  // overwritten within the same command. skip those without collecting them.
+  const unsigned keepCount = std::min( numLines, m_capacity );
+  m_reader.skipLines( numLines - keepCount );
+
+  appendList.reserve( keepCount );
+  for( unsigned i = 0; i < keepCount; ++i )
   {
-    std::string thisAppend;
-    std::getline( m_istream, thisAppend );
-    appendList.push_back( thisAppend );
+    appendList.push_back( m_reader.getLine() );
   }
-  return appendList;
+  return numLines - keepCount;
 }
 
-std::auto_ptr<const CBufCommand> InputParser::getNextCommand( /*out*/ bool& fDone )
+CBufCommandType InputParser::parseNextCommand( /*out*/ unsigned& arg, /*out*/ unsigned& count, /*out*/ std::vector<StringRef>& appendList )
 {
-  fDone = false;
+  arg = 0;
+  count = 0;
 
-  std::string thisLine;
-  std::getline( m_istream, thisLine );
+  const StringRef thisLine = m_reader.getLine();
   if( !m_didReadSize )
   {
-    const unsigned size = atoi( thisLine.c_str() );
+    m_capacity = parseUnsigned( thisLine, 0 );
     m_didReadSize = true;
-    return std::auto_ptr<const CBufCommand>( new CBufSizeCommand( size ) );
+    arg = m_capacity;
+    return kCBufSize;
   }
 
-  const char firstChar = tolower( thisLine[ 0 ] );
+  const char firstChar = thisLine.empty() ? '\0' : tolower( thisLine.data()[ 0 ] );
   switch( firstChar )
   {
   case 'a':
-    return std::auto_ptr<const CBufCommand>( new CBufAppendCommand( getAppendList( InputParser::readCountArg( thisLine ) ) ) );
+    count = getAppendList( InputParser::readCountArg( thisLine ), appendList );
+    return kCBufAppend;
   case 'r':
-    return std::auto_ptr<const CBufCommand>( new CBufRemoveCommand( InputParser::readCountArg( thisLine ) ) );
+    arg = InputParser::readCountArg( thisLine );
+    return kCBufRemove;
   case 'l':
-    return std::auto_ptr<const CBufCommand>( new CBufListCommand() );
+    return kCBufList;
+  case 'f':
+    if( !m_fFindEnabled )
+      return kCBufError;
+    // "F " followed by the exact line to look for
+    appendList.push_back( StringRef( thisLine.data() + std::min<size_t>( 2, thisLine.length() ),
+                                     thisLine.length() - std::min<size_t>( 2, thisLine.length() ) ) );
+    return kCBufFind;
+  case 'n':
+    if( !m_fNextEnabled )
+      return kCBufError;
+    parseUnsignedAt( parseUnsignedAt( thisLine.data() + 1, thisLine.data() + thisLine.length(), arg ),
+                     thisLine.data() + thisLine.length(), count );
+    return kCBufNext;
   case 'q':
+    return kCBufQuit;
+  default:
+    return kCBufError;
+  }
+}
+
+std::auto_ptr<const CBufCommand> InputParser::getNextCommand( /*out*/ bool& fDone )
+{
+  fDone = false;
+
+  unsigned arg = 0;
+  unsigned count = 0;
+  std::vector<StringRef> appendList;
+  switch( parseNextCommand( arg, count, appendList ) )
+  {
+  case kCBufSize:
+    return std::auto_ptr<const CBufCommand>( new CBufSizeCommand( arg ) );
+  case kCBufAppend:
+    return std::auto_ptr<const CBufCommand>( new CBufAppendCommand( appendList, count ) );
+  case kCBufRemove:
+    return std::auto_ptr<const CBufCommand>( new CBufRemoveCommand( arg ) );
+  case kCBufList:
+    return std::auto_ptr<const CBufCommand>( new CBufListCommand() );
+  case kCBufFind:
+    return std::auto_ptr<const CBufCommand>( new CBufFindCommand( appendList[ 0 ] ) );
+  case kCBufNext:
+    return std::auto_ptr<const CBufCommand>( new CBufNextCommand( arg, count ) );
+  case kCBufQuit:
     fDone = true;
     return std::auto_ptr<const CBufCommand>( new CBufQuitCommand() );
   default:
@@ -249,20 +322,355 @@ std::auto_ptr<const CBufCommand> InputParser::getNextCommand( /*out*/ bool& fDon
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CommandTimer: per-command latency for "cbuf -timing" (see the bench target in the makefile)
+
+class CommandTimer
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<double> m_latencies;  // seconds, one per command, parse + perform
+  Clock::time_point   m_start;
+  Clock::time_point   m_commandStart;
+
+  double percentile( const double fraction );
+
+public:
+  CommandTimer() : m_latencies(), m_start( Clock::now() ), m_commandStart( m_start )
+  {
+    m_latencies.reserve( 50001 );
+  }
+
+  void beginCommand( void ) { m_commandStart = Clock::now(); }
+  void endCommand( void ) { m_latencies.push_back( std::chrono::duration<double>( Clock::now() - m_commandStart ).count() ); }
+
+  // summary to stderr, so stdout stays comparable with an untimed run.
+  void report( const size_t inputBytes );
+};
+
+double CommandTimer::percentile( const double fraction )
+{
+  if( m_latencies.empty() )
+    return 0;
+  std::vector<double>::iterator nth = m_latencies.begin() + static_cast<size_t>( fraction * ( m_latencies.size() - 1 ) );
+  std::nth_element( m_latencies.begin(), nth, m_latencies.end() );
+  return *nth;
+}
+
+void CommandTimer::report( const size_t inputBytes )
+{
+  const double seconds = std::chrono::duration<double>( Clock::now() - m_start ).count();
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+
+  std::cerr << "commands " << m_latencies.size() << " in " << seconds << " s: "
+            << m_latencies.size() / seconds << " commands/s, "
+            << inputBytes / seconds / 1e6 << " MB/s of input" << std::endl;
+  std::cerr << "latency us: p50 " << percentile( 0.50 ) * 1e6
+            << "  p99 " << percentile( 0.99 ) * 1e6
+            << "  max " << percentile( 1.0 ) * 1e6 << std::endl;
+  std::cerr << "peak rss " << usage.ru_maxrss / 1024.0 << " MB" << std::endl;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CommandPipeline: "cbuf -pipeline" parses on one thread and performs on another, so parsing big
+//  appends overlaps with buffer work and output. commands travel by value in batches; batches
+//  cycle between the two threads through a pair of SpscCircularBuffers, so once the pool has
+//  warmed up nothing is allocated per command. the executor performs commands in input order,
+//  so the output is exactly what the sequential loop produces. a batch goes over when it's full,
+//  or early if the parser is about to wait for input, so interactive output isn't held back.
+//  either thread sleeps when the other has nothing for it (see IdleWaiter).
+
+struct CBufCommandRecord
+{
+  CBufCommandType m_type;
+  unsigned        m_arg;    // size/remove count, cursor, or the index of the append list in the batch
+  unsigned        m_count;  // lines an append skipped, or entries a cursor read asks for
+};
+
+class CommandBatch
+{
+  std::vector<CBufCommandRecord>       m_records;
+  std::vector< std::vector<StringRef> > m_appendLists;  // reused, so each keeps its capacity
+  size_t                               m_appendListCount;
+  size_t                               m_entryCount;
+
+public:
+  static const size_t kMaxRecords = 256;
+  static const size_t kMaxEntries = 16384;
+
+  CommandBatch() : m_records(), m_appendLists(), m_appendListCount( 0 ), m_entryCount( 0 )
+  {
+    m_records.reserve( kMaxRecords );
+  }
+
+  void clear( void )
+  {
+    m_records.clear();
+    m_appendListCount = 0;
+    m_entryCount = 0;
+  }
+
+  bool full( void ) const { return m_records.size() >= kMaxRecords || m_entryCount >= kMaxEntries; }
+  bool empty( void ) const { return m_records.empty(); }
+
+  // parses the next command into the batch. returns true if it ended the input (Q or error).
+  bool parseInto( InputParser& ip );
+
+  void perform( CircularBuffer& cb, CommandTimer* pTimer ) const;
+};
+
+bool CommandBatch::parseInto( InputParser& ip )
+{
+  if( m_appendListCount == m_appendLists.size() )
+  {
+    m_appendLists.push_back( std::vector<StringRef>() );
+  }
+  std::vector<StringRef>& appendList = m_appendLists[ m_appendListCount ];
+  appendList.clear();
+
+  CBufCommandRecord record;
+  record.m_type = ip.parseNextCommand( record.m_arg, record.m_count, appendList );
+  if( record.m_type == kCBufAppend || record.m_type == kCBufFind )
+  {
+    record.m_arg = m_appendListCount++;
+    m_entryCount += appendList.size();
+  }
+  m_records.push_back( record );
+  return record.m_type == kCBufQuit || record.m_type == kCBufError;
+}
+
+void CommandBatch::perform( CircularBuffer& cb, CommandTimer* pTimer ) const
+{
+  for( std::vector<CBufCommandRecord>::const_iterator it = m_records.begin(); it != m_records.end(); ++it )
+  {
+    if( pTimer )
+      pTimer->beginCommand();
+    switch( it->m_type )
+    {
+    case kCBufSize:
+      cb.setSize( it->m_arg );
+      break;
+    case kCBufAppend:
+      if( it->m_count > 0 )
+        cb.skip( it->m_count );
+      cb.append( m_appendLists[ it->m_arg ] );
+      break;
+    case kCBufRemove:
+      cb.remove( it->m_arg );
+      break;
+    case kCBufList:
+      cb.showList();
+      break;
+    case kCBufFind:
+      cb.showPositions( m_appendLists[ it->m_arg ][ 0 ] );
+      break;
+    case kCBufNext:
+      cb.showNext( it->m_arg, it->m_count );
+      break;
+    default:
+      break;
+    }
+    if( pTimer )
+      pTimer->endCommand();
+  }
+}
+
+///////////////
+
+static void runPipelined( InputParser& ip, CircularBuffer& cb, CommandTimer* pTimer )
+{
+  const size_t kBatchCount = 8;
+  std::vector<CommandBatch> pool( kBatchCount );
+
+  // a null batch pointer on the full queue means the parser is done.
+  SpscCircularBuffer<CommandBatch*> freeBatches( kBatchCount );
+  SpscCircularBuffer<CommandBatch*> fullBatches( kBatchCount + 1 );
+  IdleWaiter freeWaiter;
+  IdleWaiter fullWaiter;
+  std::vector<CommandBatch*> initial;
+  for( size_t i = 0; i < kBatchCount; ++i )
+    initial.push_back( &pool[ i ] );
+  freeBatches.append( initial );
+
+  std::thread parser( [&ip, &freeBatches, &fullBatches, &freeWaiter, &fullWaiter]()
+  {
+    bool fDone = false;
+    std::vector<CommandBatch*> handoff( 1 );
+    while( !fDone )
+    {
+      CommandBatch* pBatch = 0;
+      while( !freeBatches.pop( pBatch ) )
+        freeWaiter.wait( [&freeBatches]() { return freeBatches.size() > 0; } );
+
+      pBatch->clear();
+      while( !fDone && !pBatch->full() && ( pBatch->empty() || ip.lineBuffered() ) )
+        fDone = pBatch->parseInto( ip );
+
+      handoff[ 0 ] = pBatch;
+      fullBatches.append( handoff );
+      fullWaiter.notify();
+    }
+    handoff[ 0 ] = 0;
+    fullBatches.append( handoff );
+    fullWaiter.notify();
+  } );
+
+  std::vector<CommandBatch*> done( 1 );
+  for( ;; )
+  {
+    CommandBatch* pBatch = 0;
+    while( !fullBatches.pop( pBatch ) )
+      fullWaiter.wait( [&fullBatches]() { return fullBatches.size() > 0; } );
+    if( !pBatch )
+      break;
+
+    pBatch->perform( cb, pTimer );
+    done[ 0 ] = pBatch;
+    freeBatches.append( done );
+    freeWaiter.notify();
+  }
+  parser.join();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // main
 
+static void usage( void )
+{
+  std::cerr << "usage: cbuf [-bytering <byteBudget> | -persist <file> [-persistbytes <dataBytes>]] [-index] [-cursors] [-pipeline] [-timing] [inputFile]" << std::endl;
+  std::cerr << "       cbuf -shards <threads> [inputFile]   (keyed commands, see shard-service.h)" << std::endl;
+}
+
 int main( int argc, char **argv )
 {
-  InputParser ip( std::cin );
-  CircularBuffer cb;
+  const char* inputPath = 0;
+  size_t byteRingBudget = 0;  // 0 == original slot buffer
+  const char* persistPath = 0;
+  size_t persistBytes = 64 << 20;  // only used when the file is created
+  bool fTiming = false;
+  bool fPipeline = false;
+  bool fIndex = false;
+  bool fCursors = false;
+  bool fShards = false;
+  unsigned shardCount = 0;  // 0 == one per hardware thread
+  for( int i = 1; i < argc; ++i )
+  {
+    const std::string arg( argv[ i ] );
+    if( arg == "-bytering" && i + 1 < argc )
+    {
+      byteRingBudget = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-persist" && i + 1 < argc )
+    {
+      persistPath = argv[ ++i ];
+    }
+    else if( arg == "-persistbytes" && i + 1 < argc )
+    {
+      persistBytes = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-timing" )
+    {
+      fTiming = true;
+    }
+    else if( arg == "-pipeline" )
+    {
+      fPipeline = true;
+    }
+    else if( arg == "-index" )
+    {
+      fIndex = true;
+    }
+    else if( arg == "-cursors" )
+    {
+      fCursors = true;
+    }
+    else if( arg == "-shards" && i + 1 < argc )
+    {
+      fShards = true;
+      shardCount = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg[ 0 ] == '-' || inputPath )
+    {
+      usage();
+      return 1;
+    }
+    else
+    {
+      inputPath = argv[ i ];
+    }
+  }
+  // the index follows plain N-entry eviction, which the byte-budgeted buffers don't do.
+  // the sharded service has its own buffers and its own grammar, so it takes no other options.
+  if( ( persistPath && byteRingBudget > 0 ) || persistBytes == 0 || ( fIndex && ( persistPath || byteRingBudget > 0 ) ) ||
+      ( fShards && ( persistPath || byteRingBudget > 0 || fIndex || fCursors || fPipeline || fTiming ) ) )
+  {
+    usage();
+    return 1;
+  }
+
+  // "cbuf input.txt" maps the file, plain "cbuf" reads stdin in blocks as it comes. either way
+  // every appended entry is a view into the input, so the input must outlive the buffer, and a
+  // block of stdin only goes once the buffer can't be pointing into it (InputReleasingCircularBuffer).
+  std::auto_ptr<InputSource> pInput = InputSource::open( inputPath );
+  if( !pInput.get() )
+  {
+    std::cerr << "error: can't open input " << inputPath << std::endl;
+    return 1;
+  }
 
-  bool fDone( false );
+  if( fShards )
+  {
+    runShardService( *pInput, shardCount );
+    return 0;
+  }
+
+  InputParser ip( *pInput, fIndex, fCursors );
+  std::auto_ptr<CircularBuffer> pCb;
+  if( persistPath )
+  {
+    pCb.reset( PersistentCircularBuffer::open( persistPath, persistBytes ) );
+    if( !pCb.get() )
+    {
+      std::cerr << "error: can't open persistent buffer file " << persistPath << std::endl;
+      return 1;
+    }
+  }
+  else if( byteRingBudget > 0 )
+    pCb.reset( new ByteRingCircularBuffer( byteRingBudget ) );
+  else
+    pCb.reset( new SlotCircularBuffer() );
+
+  if( fIndex )
+    pCb.reset( new IndexedCircularBuffer( pCb.release() ) );
+  if( fCursors )
+    pCb.reset( new CursorCircularBuffer( pCb.release() ) );
+  if( !pInput->keepsAll() )
+    pCb.reset( new InputReleasingCircularBuffer( pCb.release(), *pInput ) );
+
+  std::auto_ptr<CommandTimer> pTimer( fTiming ? new CommandTimer() : 0 );
+
+  // pipelined, -timing only sees the perform half of each command.
+  if( fPipeline )
+  {
+    runPipelined( ip, *pCb, pTimer.get() );
+  }
+
+  bool fDone( fPipeline );
   while( !fDone )
   {
+    if( pTimer.get() )
+      pTimer->beginCommand();
     std::auto_ptr<const CBufCommand> pCmd = ip.getNextCommand( fDone );
-    pCmd->perform( cb );
+    pCmd->perform( *pCb );
+    if( pTimer.get() )
+      pTimer->endCommand();
   }
 
+  if( pTimer.get() )
+    pTimer->report( pInput->bytesRead() );
+
   return 0;
 }
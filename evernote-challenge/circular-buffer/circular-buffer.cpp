@@ -0,0 +1,110 @@
+// circular-buffer.cpp: SlotCircularBuffer implementation (see circular-buffer.h)
+#include "circular-buffer.h"
+#include "fixed-circular-buffer.h"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SlotCircularBuffer
+
+unsigned SlotCircularBuffer::normalizeIndex( const unsigned index ) const
+{
+  return ReciprocalModulus::reduce( index, m_reciprocal, m_maxSize );
+}
+
+void SlotCircularBuffer::setSize( const unsigned size )
+{
+  m_maxSize = size;
+  m_pFixed.reset( createFixedSlotCircularBuffer( size ) );
+  if( !m_pFixed.get() )
+  {
+    m_buf.resize( size );
+    m_reciprocal = ReciprocalModulus::reciprocalOf( std::max( size, 1u ) );
+  }
+
+  // buffer state becomes undefined when size changes,
+  // this assumes that size will be set before anything
+  // is added to buffer (a valid assumption according to spec,
+  // since size always comes first).
+}
+
+void SlotCircularBuffer::append( const std::vector<StringRef>& list )
+{
+  if( m_pFixed.get() )
+  {
+    m_pFixed->append( list );
+    return;
+  }
+  if( m_maxSize == 0 )
+  {
+    return;
+  }
+
+  if( !list.empty() )
+  {
+    m_listing.invalidate();
+  }
+
+  // we want an ordered append so avoid for_each
+  for( std::vector<StringRef>::const_iterator i = list.begin(); i != list.end(); ++i )
+  {
+    m_buf[ m_insertPoint ] = *i;
+    m_insertPoint = normalizeIndex( m_insertPoint + 1 );
+    m_itemCount = std::min( m_itemCount + 1, m_maxSize );
+  }
+}
+
+void SlotCircularBuffer::remove( const unsigned count )
+{
+  if( m_pFixed.get() )
+  {
+    m_pFixed->remove( count );
+    return;
+  }
+  if( count > 0 )
+  {
+    m_listing.invalidate();
+  }
+  m_itemCount -= std::min( count, m_itemCount );
+}
+
+void SlotCircularBuffer::showList( void )
+{
+  if( m_pFixed.get() )
+  {
+    m_pFixed->showList();
+    return;
+  }
+  if( !m_listing.isCurrent() )
+  {
+    m_listing.reset();
+    for( unsigned i = 0; i < m_itemCount; ++i )
+    {
+      m_listing.add( m_buf[ normalizeIndex( m_insertPoint + m_maxSize - m_itemCount + i ) ] );
+    }
+  }
+  m_listing.show();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FixedSlotCircularBuffer specializations
+
+CircularBuffer* createFixedSlotCircularBuffer( const unsigned size )
+{
+  // the sample inputs, round decimal sizes and the spec limit, plus powers of two.
+  switch( size )
+  {
+  case 10:    return new FixedSlotCircularBuffer<10>();
+  case 100:   return new FixedSlotCircularBuffer<100>();
+  case 1000:  return new FixedSlotCircularBuffer<1000>();
+  case 10000: return new FixedSlotCircularBuffer<10000>();
+  case 16:    return new FixedSlotCircularBuffer<16>();
+  case 64:    return new FixedSlotCircularBuffer<64>();
+  case 256:   return new FixedSlotCircularBuffer<256>();
+  case 1024:  return new FixedSlotCircularBuffer<1024>();
+  case 4096:  return new FixedSlotCircularBuffer<4096>();
+  case 8192:  return new FixedSlotCircularBuffer<8192>();
+  default:    return 0;
+  }
+}
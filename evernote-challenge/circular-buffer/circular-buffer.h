@@ -0,0 +1,78 @@
+// circular-buffer.h: the CircularBuffer interface the cbuf commands operate on, and the
+//  original one-slot-per-entry implementation.
+#ifndef CIRCULAR_BUFFER_H
+#define CIRCULAR_BUFFER_H
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "string-ref.h"
+#include "output-sink.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CircularBuffer
+
+class CircularBuffer
+{
+public:
+  virtual ~CircularBuffer() {}
+
+  virtual void setSize( const unsigned size ) = 0;
+  virtual void append( const std::vector<StringRef>& list ) = 0;
+  virtual void remove( const unsigned count ) = 0;
+  virtual void showList( void ) = 0;
+
+  // prints the list positions of the live entries equal to content ("cbuf -index", see
+  // IndexedCircularBuffer). unindexed buffers never get asked.
+  virtual void showPositions( const StringRef& ) {}
+
+  // reader cursors ("cbuf -cursors", see CursorCircularBuffer). skip is told about the lines an
+  // append never stored because the same append overwrote them (see InputParser::getAppendList),
+  // so cursors can count them as lost. showNext prints a cursor's next entries. other buffers
+  // don't number lines and never get asked for a cursor.
+  virtual void skip( const unsigned ) {}
+  virtual void showNext( const unsigned, const unsigned ) {}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SlotCircularBuffer: N is only known at runtime. common sizes are handed off to a precompiled
+//  FixedSlotCircularBuffer (see fixed-circular-buffer.h), everything else is handled here.
+
+class SlotCircularBuffer : public CircularBuffer
+{
+  unsigned m_maxSize;
+  unsigned m_insertPoint;  // always in [0, m_maxSize)
+  unsigned m_itemCount;
+
+  // entries are views into the InputSource, which outlives the buffer; appending copies no bytes.
+  std::vector<StringRef> m_buf;
+
+  // x % m_maxSize without a divide, for x in [0, 2 * m_maxSize).
+  uint64_t m_reciprocal;
+
+  std::auto_ptr<CircularBuffer> m_pFixed;
+
+  ListingSink m_listing;
+
+  unsigned normalizeIndex( const unsigned index ) const;
+
+public:
+  SlotCircularBuffer() : m_maxSize( 0 ),
+                         m_insertPoint( 0 ),
+                         m_itemCount( 0 ),
+                         m_buf( 0 ),
+                         m_reciprocal( 0 ),
+                         m_pFixed(),
+                         m_listing()
+  {
+  }
+
+  void setSize( const unsigned size );
+  void append( const std::vector<StringRef>& list );
+  void remove( const unsigned count );
+  void showList( void );
+};
+
+#endif // CIRCULAR_BUFFER_H
@@ -0,0 +1,178 @@
+// content-index.cpp: IndexedCircularBuffer implementation (see content-index.h)
+#include "content-index.h"
+
+#include <iostream>
+#include <cstring>  // memcmp
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// StringRef hashing
+
+size_t StringRefHash::operator()( const StringRef& ref ) const
+{
+  // FNV-1a
+  uint64_t hash = UINT64_C( 0xcbf29ce484222325 );
+  const unsigned char* p = reinterpret_cast<const unsigned char*>( ref.data() );
+  for( size_t i = 0; i < ref.length(); ++i )
+  {
+    hash ^= p[ i ];
+    hash *= UINT64_C( 0x100000001b3 );
+  }
+  return hash;
+}
+
+bool StringRefEqual::operator()( const StringRef& lhs, const StringRef& rhs ) const
+{
+  return lhs.length() == rhs.length() && memcmp( lhs.data(), rhs.data(), lhs.length() ) == 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// IndexedCircularBuffer
+
+IndexedCircularBuffer::IndexedCircularBuffer( CircularBuffer* inner ) :
+  m_pInner( inner ),
+  m_maxSize( 0 ),
+  m_insertSlot( 0 ),
+  m_itemCount( 0 ),
+  m_endSequence( 0 ),
+  m_slots(),
+  m_occurrences()
+{
+}
+
+void IndexedCircularBuffer::setSize( const unsigned size )
+{
+  m_pInner->setSize( size );
+  m_maxSize = size;
+  m_slots.resize( size );
+  m_occurrences.reserve( size );  // never more distinct contents than entries, so no rehashing
+}
+
+unsigned IndexedCircularBuffer::oldestSlot( void ) const
+{
+  return m_insertSlot >= m_itemCount ? m_insertSlot - m_itemCount : m_insertSlot + m_maxSize - m_itemCount;
+}
+
+void IndexedCircularBuffer::indexOne( const StringRef& content )
+{
+  if( m_itemCount == m_maxSize )
+  {
+    unindexOldest();
+  }
+
+  const unsigned slot = m_insertSlot;
+  IndexSlot& indexSlot = m_slots[ slot ];
+  indexSlot.m_content = content;
+  indexSlot.m_fHasNext = false;
+
+  std::pair<OccurrenceMap::iterator, bool> inserted = m_occurrences.insert( std::make_pair( content, Occurrences() ) );
+  Occurrences& occurrences = inserted.first->second;
+  if( inserted.second )
+  {
+    occurrences.m_oldestSequence = m_endSequence;
+    occurrences.m_oldestSlot = slot;
+    occurrences.m_count = 0;
+  }
+  else
+  {
+    IndexSlot& previous = m_slots[ occurrences.m_newestSlot ];
+    previous.m_nextSequence = m_endSequence;
+    previous.m_nextSlot = slot;
+    previous.m_fHasNext = true;
+  }
+  occurrences.m_newestSlot = slot;
+  occurrences.m_count++;
+
+  m_insertSlot = m_insertSlot + 1 == m_maxSize ? 0 : m_insertSlot + 1;
+  m_itemCount++;
+  m_endSequence++;
+}
+
+void IndexedCircularBuffer::unindexOldest( void )
+{
+  const IndexSlot& leaving = m_slots[ oldestSlot() ];
+  OccurrenceMap::iterator it = m_occurrences.find( leaving.m_content );
+  if( --it->second.m_count == 0 )
+  {
+    m_occurrences.erase( it );
+  }
+  else
+  {
+    it->second.m_oldestSequence = leaving.m_nextSequence;
+    it->second.m_oldestSlot = leaving.m_nextSlot;
+  }
+  m_itemCount--;
+}
+
+void IndexedCircularBuffer::append( const std::vector<StringRef>& list )
+{
+  m_pInner->append( list );
+  if( m_maxSize == 0 )
+  {
+    return;
+  }
+  for( std::vector<StringRef>::const_iterator i = list.begin(); i != list.end(); ++i )
+  {
+    indexOne( *i );
+  }
+}
+
+void IndexedCircularBuffer::remove( const unsigned count )
+{
+  m_pInner->remove( count );
+  for( unsigned i = 0; i < count && m_itemCount > 0; ++i )
+  {
+    unindexOldest();
+  }
+}
+
+void IndexedCircularBuffer::showList( void )
+{
+  m_pInner->showList();
+}
+
+unsigned IndexedCircularBuffer::find( const StringRef& content, /*out*/ unsigned& firstPosition ) const
+{
+  OccurrenceMap::const_iterator it = m_occurrences.find( content );
+  if( it == m_occurrences.end() )
+  {
+    return 0;
+  }
+  firstPosition = it->second.m_oldestSequence - ( m_endSequence - m_itemCount );
+  return it->second.m_count;
+}
+
+void IndexedCircularBuffer::findAll( const StringRef& content, /*out*/ std::vector<unsigned>& positions ) const
+{
+  positions.clear();
+  OccurrenceMap::const_iterator it = m_occurrences.find( content );
+  if( it == m_occurrences.end() )
+  {
+    return;
+  }
+  const uint64_t oldestLive = m_endSequence - m_itemCount;
+  uint64_t sequence = it->second.m_oldestSequence;
+  unsigned slot = it->second.m_oldestSlot;
+  for( unsigned i = 0; i < it->second.m_count; ++i )
+  {
+    positions.push_back( sequence - oldestLive );
+    sequence = m_slots[ slot ].m_nextSequence;
+    slot = m_slots[ slot ].m_nextSlot;
+  }
+}
+
+void IndexedCircularBuffer::showPositions( const StringRef& content )
+{
+  std::vector<unsigned> positions;
+  findAll( content, positions );
+  if( positions.empty() )
+  {
+    std::cout << -1 << '\n';
+    return;
+  }
+  for( size_t i = 0; i < positions.size(); ++i )
+  {
+    std::cout << ( i ? " " : "" ) << positions[ i ];
+  }
+  std::cout << '\n';
+}
@@ -0,0 +1,89 @@
+// content-index.h: CircularBuffer decorator that keeps a hash index from entry content to the
+//  live entries holding it, so "is this line still in the buffer, and where" is O(1) instead of
+//  a scan of the whole list.
+//
+//  the index is kept up to date as entries come and go: every append, eviction and remove is
+//  O(1) (amortized, for the hash table). occurrences of the same content are chained oldest to
+//  newest through a ring that parallels the buffer's slots, and since entries always leave
+//  oldest-first, the one leaving is always at the head of its chain.
+#ifndef CONTENT_INDEX_H
+#define CONTENT_INDEX_H
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "circular-buffer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// StringRef hashing
+
+struct StringRefHash
+{
+  size_t operator()( const StringRef& ref ) const;
+};
+
+struct StringRefEqual
+{
+  bool operator()( const StringRef& lhs, const StringRef& rhs ) const;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// IndexedCircularBuffer
+
+class IndexedCircularBuffer : public CircularBuffer
+{
+  // one per distinct live content
+  struct Occurrences
+  {
+    uint64_t m_oldestSequence;
+    unsigned m_oldestSlot;
+    unsigned m_newestSlot;
+    unsigned m_count;
+  };
+
+  // one per live entry, same slot layout as a slot buffer
+  struct IndexSlot
+  {
+    StringRef m_content;
+    uint64_t  m_nextSequence;  // next live entry with the same content, valid if m_fHasNext
+    unsigned  m_nextSlot;
+    bool      m_fHasNext;
+  };
+
+  typedef std::unordered_map<StringRef, Occurrences, StringRefHash, StringRefEqual> OccurrenceMap;
+
+  std::auto_ptr<CircularBuffer> m_pInner;
+
+  unsigned               m_maxSize;
+  unsigned               m_insertSlot;
+  unsigned               m_itemCount;
+  uint64_t               m_endSequence;
+  std::vector<IndexSlot> m_slots;
+  OccurrenceMap          m_occurrences;
+
+  unsigned oldestSlot( void ) const;
+  void     indexOne( const StringRef& content );
+  void     unindexOldest( void );
+
+public:
+  // takes ownership of inner, which does the actual storing and listing.
+  IndexedCircularBuffer( CircularBuffer* inner );
+
+  void setSize( const unsigned size );
+  void append( const std::vector<StringRef>& list );
+  void remove( const unsigned count );
+  void showList( void );
+  void showPositions( const StringRef& content );
+
+  // number of live entries equal to content; if any, firstPosition is the list position
+  // (0 == oldest, as L prints them) of the oldest.
+  unsigned find( const StringRef& content, /*out*/ unsigned& firstPosition ) const;
+
+  // list positions of every live entry equal to content, oldest first.
+  void findAll( const StringRef& content, /*out*/ std::vector<unsigned>& positions ) const;
+};
+
+#endif // CONTENT_INDEX_H
@@ -0,0 +1,146 @@
+// fixed-circular-buffer.h: circular buffer with its capacity fixed at compile time.
+//  slot lookups never loop or divide: power-of-two capacities index with a mask, anything else
+//  with a multiply by a precomputed reciprocal (ReciprocalModulus). SlotCircularBuffer hands its
+//  work to one of these when N is one of the sizes in createFixedSlotCircularBuffer.
+#ifndef FIXED_CIRCULAR_BUFFER_H
+#define FIXED_CIRCULAR_BUFFER_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "circular-buffer.h"
+#include "output-sink.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ReciprocalModulus: x % divisor as two multiplies (Lemire, "Faster remainder by direct
+//  computation", 2019). exact for every 32-bit x and divisor > 0.
+
+class ReciprocalModulus
+{
+  uint64_t m_reciprocal;
+  uint32_t m_divisor;
+
+public:
+  static uint64_t reciprocalOf( const uint32_t divisor ) { return UINT64_C( 0xFFFFFFFFFFFFFFFF ) / divisor + 1; }
+
+  static uint32_t reduce( const uint32_t x, const uint64_t reciprocal, const uint32_t divisor )
+  {
+    const uint64_t fraction = reciprocal * x;
+    return static_cast<uint32_t>( ( static_cast<unsigned __int128>( fraction ) * divisor ) >> 64 );
+  }
+
+  ReciprocalModulus( const uint32_t divisor = 1 ) : m_reciprocal( reciprocalOf( divisor ) ), m_divisor( divisor ) {}
+
+  uint32_t operator()( const uint32_t x ) const { return reduce( x, m_reciprocal, m_divisor ); }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FixedSlotIndex: slot for a position in [0, 2 * Capacity)
+
+template<unsigned Capacity, bool IsPowerOfTwo = ( Capacity & ( Capacity - 1 ) ) == 0>
+struct FixedSlotIndex
+{
+  static const uint64_t kReciprocal = UINT64_C( 0xFFFFFFFFFFFFFFFF ) / Capacity + 1;
+
+  static unsigned slot( const unsigned position ) { return ReciprocalModulus::reduce( position, kReciprocal, Capacity ); }
+};
+
+template<unsigned Capacity>
+struct FixedSlotIndex<Capacity, true>
+{
+  static unsigned slot( const unsigned position ) { return position & ( Capacity - 1 ); }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FixedCircularBuffer
+
+template<typename T, unsigned Capacity>
+class FixedCircularBuffer
+{
+  typedef FixedSlotIndex<Capacity> Index;
+
+  unsigned m_insertPoint;  // always in [0, Capacity)
+  unsigned m_itemCount;
+  std::vector<T> m_buf;    // sized once; heap-allocated so large capacities don't land on the stack
+
+public:
+  static const unsigned kCapacity = Capacity;
+
+  FixedCircularBuffer() : m_insertPoint( 0 ), m_itemCount( 0 ), m_buf( Capacity )
+  {
+  }
+
+  unsigned size( void ) const { return m_itemCount; }
+
+  void append( const T& item )
+  {
+    m_buf[ m_insertPoint ] = item;
+    m_insertPoint = Index::slot( m_insertPoint + 1 );
+    m_itemCount = std::min( m_itemCount + 1, Capacity );
+  }
+
+  template<typename Iterator>
+  void append( Iterator begin, const Iterator end )
+  {
+    for( ; begin != end; ++begin )
+      append( *begin );
+  }
+
+  void remove( const unsigned count )
+  {
+    m_itemCount -= std::min( count, m_itemCount );
+  }
+
+  // i == 0 is the oldest entry.
+  const T& operator[]( const unsigned i ) const
+  {
+    return m_buf[ Index::slot( m_insertPoint + Capacity - m_itemCount + i ) ];
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FixedSlotCircularBuffer: FixedCircularBuffer of views, driven by the cbuf commands
+
+template<unsigned Capacity>
+class FixedSlotCircularBuffer : public CircularBuffer
+{
+  FixedCircularBuffer<StringRef, Capacity> m_buf;
+  ListingSink m_listing;
+
+public:
+  void setSize( const unsigned ) {}  // fixed, see createFixedSlotCircularBuffer
+
+  void append( const std::vector<StringRef>& list )
+  {
+    if( !list.empty() )
+      m_listing.invalidate();
+    m_buf.append( list.begin(), list.end() );
+  }
+
+  void remove( const unsigned count )
+  {
+    if( count > 0 )
+      m_listing.invalidate();
+    m_buf.remove( count );
+  }
+
+  void showList( void )
+  {
+    if( !m_listing.isCurrent() )
+    {
+      m_listing.reset();
+      for( unsigned i = 0; i < m_buf.size(); ++i )
+        m_listing.add( m_buf[ i ] );
+    }
+    m_listing.show();
+  }
+};
+
+// returns 0 if there's no precompiled specialization for size.
+CircularBuffer* createFixedSlotCircularBuffer( const unsigned size );
+
+#endif // FIXED_CIRCULAR_BUFFER_H
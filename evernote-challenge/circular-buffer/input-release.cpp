@@ -0,0 +1,64 @@
+// input-release.cpp: InputReleasingCircularBuffer implementation (see input-release.h)
+#include "input-release.h"
+
+InputReleasingCircularBuffer::InputReleasingCircularBuffer( CircularBuffer* inner, InputSource& _input ) :
+  m_pInner( inner ),
+  m_input( _input ),
+  m_maxSize( 0 ),
+  m_appends(),
+  m_appendedCount( 0 )
+{
+}
+
+void InputReleasingCircularBuffer::setSize( const unsigned size )
+{
+  m_pInner->setSize( size );
+  m_maxSize = size;
+}
+
+void InputReleasingCircularBuffer::append( const std::vector<StringRef>& list )
+{
+  // the inner buffer may still look at what this append evicts, so release only once it's done.
+  m_pInner->append( list );
+  if( list.empty() || m_maxSize == 0 )
+  {
+    return;
+  }
+
+  Append appended;
+  appended.m_first = list.front().data();
+  appended.m_count = list.size();
+  m_appends.push_back( appended );
+  m_appendedCount += appended.m_count;
+  while( m_appendedCount - m_appends.front().m_count >= m_maxSize )
+  {
+    m_appendedCount -= m_appends.front().m_count;
+    m_appends.pop_front();
+  }
+  m_input.release( m_appends.front().m_first );
+}
+
+void InputReleasingCircularBuffer::remove( const unsigned count )
+{
+  m_pInner->remove( count );
+}
+
+void InputReleasingCircularBuffer::showList( void )
+{
+  m_pInner->showList();
+}
+
+void InputReleasingCircularBuffer::showPositions( const StringRef& content )
+{
+  m_pInner->showPositions( content );
+}
+
+void InputReleasingCircularBuffer::skip( const unsigned count )
+{
+  m_pInner->skip( count );
+}
+
+void InputReleasingCircularBuffer::showNext( const unsigned cursor, const unsigned count )
+{
+  m_pInner->showNext( cursor, count );
+}
@@ -0,0 +1,46 @@
+// input-release.h: CircularBuffer decorator that tells the InputSource how much of the input the
+//  buffer can still be pointing into, so a stream's blocks can go once no entry is a view of them
+//  (see StreamInput). a mapped input ignores it.
+//
+//  a buffer only ever holds entries from the last N lines appended to it: remove takes entries
+//  away, it never brings older ones back, and the cursors (see CursorCircularBuffer) keep the same
+//  last N. so after each append, the oldest of those lines is where the input still has to start.
+//  every command after it, performed or still queued (see runPipelined), points further in.
+#ifndef INPUT_RELEASE_H
+#define INPUT_RELEASE_H
+
+#include <deque>
+#include <memory>
+
+#include "circular-buffer.h"
+#include "input-source.h"
+
+class InputReleasingCircularBuffer : public CircularBuffer
+{
+  struct Append
+  {
+    const char* m_first;  // the first line appended
+    size_t      m_count;
+  };
+
+  std::auto_ptr<CircularBuffer> m_pInner;
+  InputSource&                  m_input;
+
+  unsigned           m_maxSize;
+  std::deque<Append> m_appends;        // oldest first, the fewest that make up the last N lines
+  size_t             m_appendedCount;  // lines in m_appends
+
+public:
+  // takes ownership of inner.
+  InputReleasingCircularBuffer( CircularBuffer* inner, InputSource& _input );
+
+  void setSize( const unsigned size );
+  void append( const std::vector<StringRef>& list );
+  void remove( const unsigned count );
+  void showList( void );
+  void showPositions( const StringRef& content );
+  void skip( const unsigned count );
+  void showNext( const unsigned cursor, const unsigned count );
+};
+
+#endif // INPUT_RELEASE_H
@@ -0,0 +1,246 @@
+// input-source.cpp: mmap and block-read implementations of InputSource (see input-source.h)
+#include "input-source.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>   // memchr, memcpy
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close, read
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// InputSource
+
+/*static*/ std::auto_ptr<InputSource> InputSource::open( const char* path )
+{
+  if( !path )
+  {
+    return std::auto_ptr<InputSource>( new StreamInput( STDIN_FILENO, false ) );
+  }
+
+  const int fd = ::open( path, O_RDONLY );
+  if( fd < 0 )
+  {
+    return std::auto_ptr<InputSource>();
+  }
+  MappedFileInput* pMapped = MappedFileInput::create( fd );
+  if( pMapped )
+  {
+    ::close( fd );  // the mapping keeps its own reference to the file.
+    return std::auto_ptr<InputSource>( pMapped );
+  }
+
+  // not mappable (a fifo, /dev/stdin, ...), read it as it comes.
+  return std::auto_ptr<InputSource>( new StreamInput( fd, true ) );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MappedFileInput
+
+/*static*/ MappedFileInput* MappedFileInput::create( const int fd )
+{
+  struct stat st;
+  if( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) )
+  {
+    return 0;
+  }
+
+  const size_t length = st.st_size;
+  if( length == 0 )
+  {
+    // mmap refuses zero-length mappings, but an empty file is a perfectly good (empty) input.
+    return new MappedFileInput( 0, 0 );
+  }
+
+  void* pMap = mmap( 0, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+  if( pMap == MAP_FAILED )
+  {
+    return 0;
+  }
+  // we scan the input front to back exactly once.
+  madvise( pMap, length, MADV_SEQUENTIAL );
+  return new MappedFileInput( static_cast<const char*>( pMap ), length );
+}
+
+MappedFileInput::~MappedFileInput()
+{
+  if( m_data )
+  {
+    munmap( const_cast<char*>( m_data ), m_length );
+  }
+}
+
+bool MappedFileInput::more( /*in,out*/ const char*& begin, /*in,out*/ const char*& end )
+{
+  if( m_fHandedOut || m_length == 0 )
+  {
+    return false;
+  }
+  m_fHandedOut = true;
+  begin = m_data;
+  end = m_data + m_length;
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamInput
+
+StreamInput::StreamInput( const int _fd, const bool _fOwnFd ) :
+  m_fd( _fd ),
+  m_fOwnFd( _fOwnFd ),
+  m_blocks(),
+  m_spare(),
+  m_used( 0 ),
+  m_bytesRead( 0 ),
+  m_fEof( false ),
+  m_keep( 0 )
+{
+}
+
+StreamInput::~StreamInput()
+{
+  if( m_fOwnFd )
+  {
+    ::close( m_fd );
+  }
+}
+
+void StreamInput::dropReleased( void )
+{
+  // the acquire pairs with release(): whoever released keep is done with everything before it.
+  const char* keep = m_keep.load( std::memory_order_acquire );
+  if( !keep )
+  {
+    return;
+  }
+  size_t dropCount = 0;
+  std::list< std::vector<char> >::const_iterator it = m_blocks.begin();
+  for( ; it != m_blocks.end(); ++it, ++dropCount )
+  {
+    if( keep >= &( *it )[ 0 ] && keep <= &( *it )[ 0 ] + it->size() )
+      break;
+  }
+  if( it == m_blocks.end() )
+  {
+    return;
+  }
+  for( ; dropCount > 0; --dropCount )
+  {
+    m_spare.swap( m_blocks.front() );
+    m_blocks.pop_front();
+  }
+}
+
+bool StreamInput::more( /*in,out*/ const char*& begin, /*in,out*/ const char*& end )
+{
+  const size_t kBlockSize = 1 << 16;
+
+  if( m_fEof )
+  {
+    return false;
+  }
+
+  // the tail is always the end of the last block. if there's no room after it, start a new block
+  // (big enough for a long line to keep growing) and carry the tail over. the old block stays
+  // until it's released, earlier lines still point into it.
+  const size_t tailLength = end - begin;
+  if( m_blocks.empty() || m_used == m_blocks.back().size() )
+  {
+    dropReleased();
+    const size_t blockSize = std::max( kBlockSize, tailLength * 2 );
+    if( m_spare.size() >= blockSize )
+    {
+      m_blocks.push_back( std::vector<char>() );
+      m_blocks.back().swap( m_spare );
+    }
+    else
+    {
+      m_blocks.push_back( std::vector<char>( blockSize ) );
+    }
+    if( tailLength > 0 )
+    {
+      memcpy( &m_blocks.back()[ 0 ], begin, tailLength );
+    }
+    m_used = tailLength;
+    begin = &m_blocks.back()[ 0 ];
+    end = begin + tailLength;
+  }
+
+  std::vector<char>& block = m_blocks.back();
+  ssize_t got;
+  do
+  {
+    got = ::read( m_fd, &block[ m_used ], block.size() - m_used );
+  } while( got < 0 && errno == EINTR );
+  if( got <= 0 )
+  {
+    m_fEof = true;
+    return false;
+  }
+  m_used += got;
+  m_bytesRead += got;
+  end = &block[ 0 ] + m_used;
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// LineReader
+
+size_t LineReader::scanLines( const unsigned count )
+{
+  size_t offset = 0;  // from m_cur, which more() may move
+  for( unsigned found = 0; found < count; )
+  {
+    const char* newline = m_cur + offset != m_end ? static_cast<const char*>( memchr( m_cur + offset, '\n', m_end - m_cur - offset ) ) : 0;
+    if( newline )
+    {
+      offset = newline + 1 - m_cur;
+      ++found;
+    }
+    else if( !m_input.more( m_cur, m_end ) )
+    {
+      return m_end - m_cur;
+    }
+  }
+  return offset;
+}
+
+bool LineReader::lineBuffered( void ) const
+{
+  return m_cur != m_end && memchr( m_cur, '\n', m_end - m_cur ) != 0;
+}
+
+const StringRef LineReader::getLine( void )
+{
+  const size_t length = scanLines( 1 );
+  const char* lineStart = m_cur;
+  m_cur += length;
+  const bool fNewline = length > 0 && lineStart[ length - 1 ] == '\n';
+  return StringRef( lineStart, fNewline ? length - 1 : length );
+}
+
+const StringRef LineReader::getLines( const unsigned count )
+{
+  const size_t length = scanLines( count );
+  const char* linesStart = m_cur;
+  m_cur += length;
+  return StringRef( linesStart, length );
+}
+
+void LineReader::skipLines( unsigned count )
+{
+  // a line at a time, so reading from a stream never has to keep skipped lines contiguous.
+  while( count-- > 0 )
+  {
+    const size_t length = scanLines( 1 );
+    if( length == 0 )
+    {
+      break;
+    }
+    m_cur += length;
+  }
+}
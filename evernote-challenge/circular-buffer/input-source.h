@@ -0,0 +1,130 @@
+// input-source.h: hand out the cbuf input as lines that are views into it.
+//  a named file is memory-mapped, so lines point straight into the mapping with no copying.
+//  anything else (stdin, pipes, files that can't be mapped) is read in blocks as it arrives, so
+//  each command runs as soon as its lines are in rather than after the whole input. a block is
+//  kept until the consumer says (release) that nothing points into it any more, so reading a
+//  stream takes memory for what the buffer still holds, not for all of the input.
+#ifndef INPUT_SOURCE_H
+#define INPUT_SOURCE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "string-ref.h"
+
+class InputSource
+{
+public:
+  virtual ~InputSource() {}
+
+  // begin..end is the unread tail of what was handed out so far (both 0 at the start). makes more
+  // input available after it, moving the tail into a new block if that's what it takes to keep it
+  // contiguous with what follows. false at end of input.
+  virtual bool more( /*in,out*/ const char*& begin, /*in,out*/ const char*& end ) = 0;
+
+  // bytes of input handed out so far.
+  virtual size_t bytesRead( void ) const = 0;
+
+  // nothing handed out before keep will be looked at again, so the input it's in may go. keep
+  // only ever moves forward. may be called from another thread than more(); a mapping ignores it.
+  virtual void release( const char* keep ) {}
+
+  // true if everything handed out stays valid as long as the input does, released or not.
+  virtual bool keepsAll( void ) const = 0;
+
+  // path == 0 means stdin. returns an empty auto_ptr if the input can't be opened.
+  static std::auto_ptr<InputSource> open( const char* path );
+};
+
+///////////////
+
+class MappedFileInput : public InputSource
+{
+  const char* m_data;
+  size_t      m_length;
+  bool        m_fHandedOut;
+
+  MappedFileInput( const char* _data, const size_t _length ) : m_data( _data ), m_length( _length ), m_fHandedOut( false ) {}
+
+  // not copyable, we own the mapping.
+  MappedFileInput( const MappedFileInput& );
+  MappedFileInput& operator=( const MappedFileInput& );
+
+public:
+  ~MappedFileInput();
+
+  // all of it the first time, nothing after.
+  bool more( /*in,out*/ const char*& begin, /*in,out*/ const char*& end );
+  size_t bytesRead( void ) const { return m_fHandedOut ? m_length : 0; }
+  bool keepsAll( void ) const { return true; }
+
+  // returns 0 if the file can't be mapped (caller should fall back to StreamInput).
+  static MappedFileInput* create( const int fd );
+};
+
+///////////////
+
+class StreamInput : public InputSource
+{
+  const int                      m_fd;
+  const bool                     m_fOwnFd;
+  std::list< std::vector<char> > m_blocks;  // never moved; dropped from the front once released
+  std::vector<char>              m_spare;    // the last block dropped, to be reused
+  size_t                         m_used;     // bytes filled in the last block
+  size_t                         m_bytesRead;
+  bool                           m_fEof;
+  std::atomic<const char*>       m_keep;     // see release()
+
+  void dropReleased( void );
+
+  // not copyable, we may own the fd.
+  StreamInput( const StreamInput& );
+  StreamInput& operator=( const StreamInput& );
+
+public:
+  StreamInput( const int _fd, const bool _fOwnFd );
+  ~StreamInput();
+
+  // takes whatever a read() returns, so it only blocks when nothing at all is available.
+  bool more( /*in,out*/ const char*& begin, /*in,out*/ const char*& end );
+  size_t bytesRead( void ) const { return m_bytesRead; }
+  bool keepsAll( void ) const { return false; }
+
+  // the blocks before the one holding keep are dropped the next time a block is started.
+  void release( const char* keep ) { m_keep.store( keep, std::memory_order_release ); }
+};
+
+///////////////
+
+// walks an InputSource front to back handing out lines as views into it.
+class LineReader
+{
+  InputSource& m_input;
+  const char*  m_cur;  // next unread byte of the input
+  const char*  m_end;  // end of what the input has handed out
+
+  // bytes from m_cur through the end of the next count lines (the last one may lack its newline
+  // at the end of input), reading more as needed. fewer lines if the input runs out.
+  size_t scanLines( const unsigned count );
+
+public:
+  LineReader( InputSource& _input ) : m_input( _input ), m_cur( 0 ), m_end( 0 ) {}
+
+  // true if the next line is already in, so getLine won't have to read (and maybe wait for) more.
+  bool lineBuffered( void ) const;
+
+  // where the next line starts: everything handed out so far is before it.
+  const char* position( void ) const { return m_cur; }
+
+  // returns a view of the next line (without its newline), or an empty view at end of input.
+  const StringRef getLine( void );
+
+  // one view of the next count lines, newlines included.
+  const StringRef getLines( const unsigned count );
+
+  void skipLines( unsigned count );
+};
+
+#endif // INPUT_SOURCE_H
@@ -0,0 +1,115 @@
+// mpmc-bench.cpp: MpmcCircularBuffer throughput as the number of producer/consumer threads grows.
+//  for each k in 1..maxThreads, k producers append batches of sequenced entries while k consumers
+//  drain them; reports throughput, overruns, and whether each producer's entries arrived in order.
+//  usage: mpmc-bench [entryCount] [capacity] [batchSize] [maxThreads]
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>   // strtoul
+#include <stdint.h>
+
+#include "mpmc-circular-buffer.h"
+
+// entries are (producer << 40) | sequence within that producer
+static const unsigned kProducerShift = 40;
+
+static void runOnce( const size_t entryCount, const size_t capacity, const size_t batchSize, const unsigned threadCount )
+{
+  MpmcCircularBuffer<uint64_t> buf( capacity );
+  const size_t perProducer = entryCount / threadCount;
+  const size_t total = perProducer * threadCount;
+
+  std::vector<std::thread> threads;
+  std::vector<size_t> delivered( threadCount, 0 );
+  std::vector<char> orderOk( threadCount, 1 );
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for( unsigned p = 0; p < threadCount; ++p )
+  {
+    threads.push_back( std::thread( [&buf, p, perProducer, batchSize]()
+    {
+      std::vector<uint64_t> batch;
+      batch.reserve( batchSize );
+      for( size_t next = 0; next < perProducer; )
+      {
+        batch.clear();
+        for( ; batch.size() < batchSize && next < perProducer; ++next )
+          batch.push_back( ( uint64_t( p ) << kProducerShift ) | next );
+        buf.append( batch );
+      }
+    } ) );
+  }
+
+  for( unsigned c = 0; c < threadCount; ++c )
+  {
+    threads.push_back( std::thread( [&buf, &delivered, &orderOk, c, total, batchSize, threadCount]()
+    {
+      // positions are claimed in increasing order, so each consumer must see every producer's
+      // sequence numbers increase.
+      std::vector<uint64_t> lastSeen( threadCount, 0 );
+      std::vector<uint64_t> out;
+      out.reserve( batchSize );
+      while( buf.readPosition() < total )
+      {
+        out.clear();
+        if( buf.drain( out, batchSize ) == 0 )
+        {
+          std::this_thread::yield();
+          continue;
+        }
+        for( std::vector<uint64_t>::const_iterator it = out.begin(); it != out.end(); ++it )
+        {
+          const unsigned producer = *it >> kProducerShift;
+          const uint64_t seq = ( *it & ( ( uint64_t( 1 ) << kProducerShift ) - 1 ) ) + 1;
+          if( producer >= threadCount || seq <= lastSeen[ producer ] )
+            orderOk[ c ] = 0;
+          else
+            lastSeen[ producer ] = seq;
+        }
+        delivered[ c ] += out.size();
+      }
+    } ) );
+  }
+
+  for( std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it )
+    it->join();
+  const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+  size_t deliveredTotal = 0;
+  bool fOk = true;
+  for( unsigned c = 0; c < threadCount; ++c )
+  {
+    deliveredTotal += delivered[ c ];
+    fOk = fOk && orderOk[ c ];
+  }
+  fOk = fOk && ( deliveredTotal + buf.overrunCount() == total );
+
+  std::cout << threadCount << "P/" << threadCount << "C: appended " << total / seconds / 1e6 << " M entries/s"
+            << ", delivered " << deliveredTotal / seconds / 1e6 << " M entries/s"
+            << " (" << deliveredTotal << " delivered, " << buf.overrunCount() << " overrun)"
+            << ( fOk ? "" : "  ** MISMATCH **" ) << std::endl;
+}
+
+int main( int argc, char **argv )
+{
+  const size_t entryCount  = argc > 1 ? strtoul( argv[ 1 ], 0, 10 ) : 20000000;
+  const size_t capacity    = argc > 2 ? strtoul( argv[ 2 ], 0, 10 ) : 65536;
+  const size_t batchSize   = argc > 3 ? strtoul( argv[ 3 ], 0, 10 ) : 64;
+  unsigned maxThreads      = argc > 4 ? strtoul( argv[ 4 ], 0, 10 ) : std::thread::hardware_concurrency();
+  if( batchSize == 0 )
+  {
+    std::cerr << "usage: mpmc-bench [entryCount] [capacity] [batchSize > 0] [maxThreads]" << std::endl;
+    return 1;
+  }
+  maxThreads = std::max( maxThreads, 1u );
+
+  std::cout << "entries " << entryCount << ", capacity " << capacity << ", batch " << batchSize
+            << ", hardware threads " << std::thread::hardware_concurrency() << std::endl;
+  for( unsigned k = 1; k <= maxThreads; ++k )
+  {
+    runOnce( entryCount, capacity, batchSize, k );
+  }
+  return 0;
+}
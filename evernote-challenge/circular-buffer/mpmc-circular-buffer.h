@@ -0,0 +1,233 @@
+// mpmc-circular-buffer.h: multi-producer/multi-consumer circular buffer with overwrite-oldest
+//  semantics, for many ingest threads feeding several drain workers.
+//
+//  producers claim a whole batch of positions with one fetch_add on m_tail and never wait for
+//  consumers: like SlotCircularBuffer, a full ring overwrites its oldest entries. each slot carries
+//  a sequence number saying which position it holds and whether that position is fully written:
+//
+//    m_seq == 2p + 1   position p is being written
+//    m_seq == 2p + 2   position p is committed (0 == never written)
+//
+//  a producer writing position p waits only for the previous occupant of its slot (p - slotCount)
+//  to be committed, so writes to a slot land in position order. consumers claim positions by
+//  advancing m_head; if the producers have lapped m_head, the lapped positions are skipped (counted
+//  as overruns) before claiming. a consumer copies a committed slot and re-checks m_seq afterwards,
+//  so an entry overwritten mid-copy is dropped as an overrun rather than returned torn: every
+//  position is either delivered intact exactly once or counted in overrunCount().
+//
+//  slot payloads are stored as relaxed atomic words so that the optimistic copy is well defined;
+//  T must be trivially copyable (StringRef, integers, ...).
+#ifndef MPMC_CIRCULAR_BUFFER_H
+#define MPMC_CIRCULAR_BUFFER_H
+
+#include <atomic>
+#include <thread>   // yield
+#include <vector>
+#include <algorithm>
+#include <cstring>  // memcpy
+#include <stdint.h>
+#include <type_traits>
+
+#include "spsc-circular-buffer.h"  // CBUF_CACHE_LINE_SIZE
+
+template<typename T>
+class MpmcCircularBuffer
+{
+  static_assert( std::is_trivially_copyable<T>::value, "MpmcCircularBuffer entries must be trivially copyable" );
+
+  static const size_t kWordCount = ( sizeof( T ) + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t );
+
+  struct Slot
+  {
+    std::atomic<size_t>   m_seq;
+    std::atomic<uint64_t> m_words[ kWordCount ];
+  };
+
+  alignas( CBUF_CACHE_LINE_SIZE ) std::atomic<size_t> m_tail;          // next position to claim for writing
+  alignas( CBUF_CACHE_LINE_SIZE ) std::atomic<size_t> m_head;          // next position to claim for reading
+  alignas( CBUF_CACHE_LINE_SIZE ) std::atomic<size_t> m_overrunCount;  // positions lost to overwrite
+
+  alignas( CBUF_CACHE_LINE_SIZE ) const size_t m_mask;
+  std::vector<Slot> m_slots;
+
+  static size_t roundUpToPowerOfTwo( const size_t value )
+  {
+    size_t result = 1;
+    while( result < value )
+      result <<= 1;
+    return result;
+  }
+
+  static size_t committedSeq( const size_t position ) { return 2 * position + 2; }
+
+  static void spinWait( unsigned& spins )
+  {
+    if( ++spins > 64 )
+      std::this_thread::yield();
+  }
+
+  void writeSlot( const size_t position, const T& item )
+  {
+    Slot& slot = m_slots[ position & m_mask ];
+    const size_t slotCount = m_mask + 1;
+    const size_t previousSeq = position >= slotCount ? committedSeq( position - slotCount ) : 0;
+
+    // the previous lap's writer may still be mid-write. wait for it so writes stay in order.
+    unsigned spins = 0;
+    while( slot.m_seq.load( std::memory_order_acquire ) != previousSeq )
+      spinWait( spins );
+
+    slot.m_seq.store( committedSeq( position ) - 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );  // readers that see the new words also see the odd seq
+
+    uint64_t words[ kWordCount ] = { 0 };
+    memcpy( words, &item, sizeof( T ) );
+    for( size_t i = 0; i < kWordCount; ++i )
+      slot.m_words[ i ].store( words[ i ], std::memory_order_relaxed );
+
+    slot.m_seq.store( committedSeq( position ), std::memory_order_release );
+  }
+
+  // returns false if position was overwritten before we could copy it out.
+  bool readSlot( const size_t position, T& out )
+  {
+    Slot& slot = m_slots[ position & m_mask ];
+    const size_t expectedSeq = committedSeq( position );
+
+    // the position was claimed by a producer (it is below m_tail) but may not be written yet.
+    unsigned spins = 0;
+    size_t seq;
+    while( ( seq = slot.m_seq.load( std::memory_order_acquire ) ) < expectedSeq )
+      spinWait( spins );
+    if( seq != expectedSeq )
+      return false;
+
+    uint64_t words[ kWordCount ];
+    for( size_t i = 0; i < kWordCount; ++i )
+      words[ i ] = slot.m_words[ i ].load( std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_acquire );  // order the copy before the re-check
+    if( slot.m_seq.load( std::memory_order_relaxed ) != expectedSeq )
+      return false;
+
+    memcpy( &out, words, sizeof( T ) );
+    return true;
+  }
+
+  // claims up to maxCount readable positions starting at the returned position, skipping any
+  // the producers have already lapped.
+  size_t claimForRead( const size_t maxCount, /*out*/ size_t& first )
+  {
+    const size_t slotCount = m_mask + 1;
+    size_t head = m_head.load( std::memory_order_relaxed );
+    for( ;; )
+    {
+      const size_t tail = m_tail.load( std::memory_order_acquire );
+      size_t start = head;
+      if( tail - start > slotCount )
+        start = tail - slotCount;
+      const size_t count = std::min( maxCount, tail - start );
+      if( count == 0 )
+        return 0;
+      if( m_head.compare_exchange_weak( head, start + count, std::memory_order_acq_rel, std::memory_order_relaxed ) )
+      {
+        if( start != head )
+          m_overrunCount.fetch_add( start - head, std::memory_order_relaxed );
+        first = start;
+        return count;
+      }
+      // another consumer moved m_head; head now holds its value, go again.
+    }
+  }
+
+  // not copyable.
+  MpmcCircularBuffer( const MpmcCircularBuffer& );
+  MpmcCircularBuffer& operator=( const MpmcCircularBuffer& );
+
+public:
+  // capacity is rounded up to a power of two so slots can be found with a mask.
+  MpmcCircularBuffer( const size_t capacity ) :
+    m_mask( roundUpToPowerOfTwo( std::max<size_t>( capacity, 1 ) ) - 1 ),
+    m_slots( m_mask + 1 )
+  {
+    m_tail.store( 0, std::memory_order_relaxed );
+    m_head.store( 0, std::memory_order_relaxed );
+    m_overrunCount.store( 0, std::memory_order_relaxed );
+    for( typename std::vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it )
+      it->m_seq.store( 0, std::memory_order_relaxed );
+  }
+
+  size_t capacity( void ) const { return m_mask + 1; }
+  size_t overrunCount( void ) const { return m_overrunCount.load( std::memory_order_relaxed ); }
+
+  // positions claimed so far by producers/consumers; consumers are done once readPosition()
+  // reaches the number of entries appended.
+  size_t writePosition( void ) const { return m_tail.load( std::memory_order_acquire ); }
+  size_t readPosition( void ) const { return m_head.load( std::memory_order_acquire ); }
+
+  ///////////////
+  // producer side, any number of threads
+
+  // the whole batch is claimed with one atomic add, so a batch is contiguous in position order
+  // even with other producers appending concurrently.
+  void append( const T* items, const size_t count )
+  {
+    if( count == 0 )
+      return;
+    const size_t first = m_tail.fetch_add( count, std::memory_order_acq_rel );
+    for( size_t i = 0; i < count; ++i )
+      writeSlot( first + i, items[ i ] );
+  }
+
+  void append( const std::vector<T>& list )
+  {
+    if( !list.empty() )
+      append( &list[ 0 ], list.size() );
+  }
+
+  ///////////////
+  // consumer side, any number of threads
+
+  // appends up to maxCount of the oldest entries to out. returns how many were delivered, which
+  // can be less than were claimed if producers overwrote some of them mid-read.
+  size_t drain( std::vector<T>& out, const size_t maxCount )
+  {
+    size_t first = 0;
+    const size_t claimed = claimForRead( maxCount, first );
+    size_t delivered = 0;
+    for( size_t i = 0; i < claimed; ++i )
+    {
+      T item;
+      if( readSlot( first + i, item ) )
+      {
+        out.push_back( item );
+        ++delivered;
+      }
+      else
+      {
+        m_overrunCount.fetch_add( 1, std::memory_order_relaxed );
+      }
+    }
+    return delivered;
+  }
+
+  bool pop( T& out )
+  {
+    size_t first = 0;
+    while( claimForRead( 1, first ) == 1 )
+    {
+      if( readSlot( first, out ) )
+        return true;
+      m_overrunCount.fetch_add( 1, std::memory_order_relaxed );
+    }
+    return false;
+  }
+
+  // discards up to count of the oldest entries (the cbuf "R n" command). returns how many.
+  size_t remove( const size_t count )
+  {
+    size_t first = 0;
+    return claimForRead( count, first );
+  }
+};
+
+#endif // MPMC_CIRCULAR_BUFFER_H
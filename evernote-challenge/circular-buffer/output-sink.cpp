@@ -0,0 +1,59 @@
+// output-sink.cpp: stdout writers for cbuf listings (see output-sink.h)
+#include "output-sink.h"
+
+#include <iostream>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>  // STDOUT_FILENO
+
+bool writeAllToStdout( struct iovec* spans, int spanCount )
+{
+  // anything already queued in cout has to go out first to keep the output in order.
+  std::cout.flush();
+
+  while( spanCount > 0 )
+  {
+    const ssize_t written = writev( STDOUT_FILENO, spans, spanCount );
+    if( written < 0 )
+    {
+      if( errno == EINTR )
+        continue;
+      return false;
+    }
+    // short write: skip what went out and retry with the rest.
+    size_t remaining = written;
+    while( spanCount > 0 && remaining >= spans->iov_len )
+    {
+      remaining -= spans->iov_len;
+      ++spans;
+      --spanCount;
+    }
+    if( spanCount > 0 )
+    {
+      spans->iov_base = static_cast<char*>( spans->iov_base ) + remaining;
+      spans->iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
+void ListingSink::grow( const size_t needed )
+{
+  size_t newSize = std::max<size_t>( m_buf.size() * 2, 4096 );
+  while( newSize < needed )
+    newSize *= 2;
+  m_buf.resize( newSize );
+}
+
+void ListingSink::show( void )
+{
+  m_fCurrent = true;
+  if( m_length == 0 )
+  {
+    return;
+  }
+  struct iovec span;
+  span.iov_base = &m_buf[ 0 ];
+  span.iov_len = m_length;
+  writeAllToStdout( &span, 1 );
+}
@@ -0,0 +1,55 @@
+// output-sink.h: get cbuf output to stdout in as few syscalls as possible.
+//  ListingSink renders a whole L listing into one reusable buffer and writes it with a single
+//  write; the rendered listing is kept until the buffer contents change, so repeated L commands
+//  with nothing in between cost one syscall and no copying.
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <vector>
+#include <cstring>    // memcpy
+#include <sys/uio.h>  // iovec
+
+#include "string-ref.h"
+
+// writev to stdout, retrying on short writes and EINTR. spans are modified. false on error.
+bool writeAllToStdout( struct iovec* spans, int spanCount );
+
+class ListingSink
+{
+  std::vector<char> m_buf;     // grows to the largest listing seen, never shrinks
+  size_t            m_length;  // bytes of m_buf in use
+  bool              m_fCurrent;
+
+  void grow( const size_t needed );
+
+public:
+  ListingSink() : m_buf(), m_length( 0 ), m_fCurrent( false ) {}
+
+  // call whenever the buffer contents change.
+  void invalidate( void ) { m_fCurrent = false; }
+
+  // true if the last rendered listing can be shown again as is.
+  bool isCurrent( void ) const { return m_fCurrent; }
+
+  // start rendering a new listing.
+  void reset( void )
+  {
+    m_length = 0;
+    m_fCurrent = false;
+  }
+
+  void add( const StringRef& entry )
+  {
+    const size_t needed = m_length + entry.length() + 1;
+    if( needed > m_buf.size() )
+      grow( needed );
+    memcpy( &m_buf[ m_length ], entry.data(), entry.length() );
+    m_buf[ needed - 1 ] = '\n';
+    m_length = needed;
+  }
+
+  // marks the rendered listing current and writes it out.
+  void show( void );
+};
+
+#endif // OUTPUT_SINK_H
@@ -0,0 +1,329 @@
+// persistent-circular-buffer.cpp: PersistentCircularBuffer implementation (see persistent-circular-buffer.h)
+#include "persistent-circular-buffer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>      // atomic_thread_fence
+#include <cstdlib>     // exit
+#include <cstring>     // memcpy
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // ftruncate, pread, close
+
+static const uint64_t kPersistentMagic   = UINT64_C( 0x6362756670657273 );  // "cbufpers"
+static const uint32_t kPersistentVersion = 1;
+static const size_t   kPageSize          = 4096;
+
+static size_t roundUpToPage( const size_t bytes )
+{
+  return ( bytes + kPageSize - 1 ) / kPageSize * kPageSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// PersistentCircularBuffer
+
+PersistentCircularBuffer::PersistentCircularBuffer( const std::string& _path, const size_t _dataBytes, const int _fd ) :
+  m_path( _path ),
+  m_dataBytes( _dataBytes ),
+  m_fd( _fd ),
+  m_pMap( 0 ),
+  m_mapLength( 0 ),
+  m_pHeader( 0 ),
+  m_pSlots( 0 ),
+  m_pData( 0 ),
+  m_state(),
+  m_listing()
+{
+}
+
+PersistentCircularBuffer::~PersistentCircularBuffer()
+{
+  if( m_pMap )
+  {
+    munmap( m_pMap, m_mapLength );
+  }
+  ::close( m_fd );
+}
+
+/*static*/ PersistentCircularBuffer* PersistentCircularBuffer::open( const std::string& path, const size_t dataBytes )
+{
+  const int fd = ::open( path.c_str(), O_RDWR | O_CREAT, 0644 );
+  if( fd < 0 )
+  {
+    return 0;
+  }
+  return new PersistentCircularBuffer( path, dataBytes, fd );
+}
+
+/*static*/ uint64_t PersistentCircularBuffer::checksumOf( const PersistentState& state )
+{
+  // FNV-1a over the state fields; only has to catch a state copy that was half written.
+  const uint64_t fields[] = { state.m_generation, state.m_dataTail, state.m_insertPoint, state.m_count };
+  uint64_t hash = UINT64_C( 0xcbf29ce484222325 );
+  const unsigned char* p = reinterpret_cast<const unsigned char*>( fields );
+  for( size_t i = 0; i < sizeof( fields ); ++i )
+  {
+    hash ^= p[ i ];
+    hash *= UINT64_C( 0x100000001b3 );
+  }
+  return hash ? hash : 1;
+}
+
+bool PersistentCircularBuffer::mapFile( const unsigned capacity )
+{
+  const size_t slotBytes = roundUpToPage( capacity * sizeof( PersistentSlot ) );
+  m_mapLength = roundUpToPage( sizeof( PersistentHeader ) ) + slotBytes + m_dataBytes;
+
+  struct stat st;
+  if( fstat( m_fd, &st ) != 0 )
+  {
+    return false;
+  }
+  if( static_cast<size_t>( st.st_size ) != m_mapLength && ftruncate( m_fd, m_mapLength ) != 0 )
+  {
+    return false;
+  }
+
+  void* pMap = mmap( 0, m_mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0 );
+  if( pMap == MAP_FAILED )
+  {
+    return false;
+  }
+  m_pMap = static_cast<char*>( pMap );
+  m_pHeader = reinterpret_cast<PersistentHeader*>( m_pMap );
+  m_pSlots = reinterpret_cast<PersistentSlot*>( m_pMap + roundUpToPage( sizeof( PersistentHeader ) ) );
+  m_pData = m_pMap + roundUpToPage( sizeof( PersistentHeader ) ) + slotBytes;
+  return true;
+}
+
+bool PersistentCircularBuffer::reattach( const unsigned capacity )
+{
+  PersistentHeader header;
+  if( pread( m_fd, &header, sizeof( header ), 0 ) != sizeof( header ) ||
+      header.m_magic != kPersistentMagic ||
+      header.m_version != kPersistentVersion ||
+      header.m_capacity != capacity ||
+      header.m_dataBytes == 0 )
+  {
+    return false;
+  }
+
+  // the data size is fixed when the file is created, and the file is exactly that big. (checked
+  // before mapping: mapFile would otherwise resize the file to whatever the header claims.)
+  struct stat st;
+  if( fstat( m_fd, &st ) != 0 ||
+      header.m_dataBytes > static_cast<uint64_t>( st.st_size ) ||
+      static_cast<uint64_t>( st.st_size ) != roundUpToPage( sizeof( PersistentHeader ) ) + roundUpToPage( capacity * sizeof( PersistentSlot ) ) + header.m_dataBytes )
+  {
+    return false;
+  }
+  m_dataBytes = header.m_dataBytes;
+  if( !mapFile( capacity ) )
+  {
+    return false;
+  }
+
+  const PersistentState* pCurrent = 0;
+  for( int i = 0; i < 2; ++i )
+  {
+    const PersistentState& state = m_pHeader->m_state[ i ];
+    const bool fValid = state.m_checksum == checksumOf( state ) &&
+                        state.m_insertPoint < std::max( capacity, 1u ) &&
+                        state.m_count <= capacity;
+    if( fValid && ( !pCurrent || state.m_generation > pCurrent->m_generation ) )
+    {
+      pCurrent = &state;
+    }
+  }
+  if( !pCurrent )
+  {
+    return false;
+  }
+  m_state = *pCurrent;
+  return slotsValid();
+}
+
+// the live entries, oldest first, must each lie within the data ring without crossing its end,
+// follow one another without overlapping, and all be among the last m_dataBytes bytes before the
+// data tail; otherwise showList would read garbage, or past the mapping.
+bool PersistentCircularBuffer::slotsValid( void ) const
+{
+  const unsigned capacity = m_pHeader->m_capacity;
+  const uint64_t tail = m_state.m_dataTail;
+  uint64_t end = tail >= m_dataBytes ? tail - m_dataBytes : 0;  // where the next entry may start
+  unsigned slot = oldestSlot();
+  for( unsigned i = 0; i < m_state.m_count; ++i )
+  {
+    const PersistentSlot& s = m_pSlots[ slot ];
+    if( s.m_position < end ||
+        s.m_position > tail ||
+        s.m_length > tail - s.m_position ||
+        s.m_position % m_dataBytes + s.m_length > m_dataBytes )
+    {
+      return false;
+    }
+    end = s.m_position + s.m_length;
+    if( ++slot == capacity )
+      slot = 0;
+  }
+  return true;
+}
+
+void PersistentCircularBuffer::format( const unsigned capacity )
+{
+  if( m_pMap )
+  {
+    munmap( m_pMap, m_mapLength );
+    m_pMap = 0;
+  }
+  if( ftruncate( m_fd, 0 ) != 0 || !mapFile( capacity ) )
+  {
+    std::cerr << "error: can't size persistent buffer file " << m_path << std::endl;
+    exit( 1 );
+  }
+
+  memset( m_pHeader, 0, sizeof( PersistentHeader ) );
+  m_pHeader->m_version = kPersistentVersion;
+  m_pHeader->m_capacity = capacity;
+  m_pHeader->m_dataBytes = m_dataBytes;
+  memset( &m_state, 0, sizeof( m_state ) );
+  commit();
+
+  // the magic goes in last: a crash while formatting leaves a file that gets formatted again.
+  std::atomic_thread_fence( std::memory_order_release );
+  m_pHeader->m_magic = kPersistentMagic;
+}
+
+void PersistentCircularBuffer::setSize( const unsigned size )
+{
+  m_listing.invalidate();
+  if( !reattach( size ) )
+  {
+    struct stat st;
+    if( fstat( m_fd, &st ) == 0 && st.st_size > 0 )
+    {
+      std::cerr << "warning: " << m_path << " doesn't hold a usable buffer of size " << size << ", starting empty" << std::endl;
+    }
+    format( size );
+  }
+}
+
+void PersistentCircularBuffer::commit( void )
+{
+  m_state.m_generation++;
+  m_state.m_checksum = checksumOf( m_state );
+
+  // overwrite the copy that isn't current. it's invalid from the moment its checksum is cleared
+  // until the new checksum lands, so a crash in between falls back to the current copy.
+  PersistentState& target = m_pHeader->m_state[ m_state.m_generation & 1 ];
+  target.m_checksum = 0;
+  std::atomic_thread_fence( std::memory_order_release );
+  target.m_generation = m_state.m_generation;
+  target.m_dataTail = m_state.m_dataTail;
+  target.m_insertPoint = m_state.m_insertPoint;
+  target.m_count = m_state.m_count;
+  std::atomic_thread_fence( std::memory_order_release );
+  target.m_checksum = m_state.m_checksum;
+}
+
+unsigned PersistentCircularBuffer::oldestSlot( void ) const
+{
+  return m_state.m_insertPoint >= m_state.m_count ? m_state.m_insertPoint - m_state.m_count
+                                                  : m_state.m_insertPoint + m_pHeader->m_capacity - m_state.m_count;
+}
+
+void PersistentCircularBuffer::evictOldest( void )
+{
+  m_state.m_count--;
+}
+
+void PersistentCircularBuffer::appendOne( const StringRef& entry )
+{
+  const unsigned capacity = m_pHeader->m_capacity;
+  if( capacity == 0 )
+  {
+    return;
+  }
+  if( entry.length() > m_dataBytes )
+  {
+    // can never fit, same as ByteRingCircularBuffer: everything older goes and so does this.
+    m_state.m_count = 0;
+    commit();
+    return;
+  }
+
+  // entries don't wrap, skip the end of the ring if this one doesn't fit there.
+  uint64_t position = m_state.m_dataTail;
+  const size_t ringOffset = position % m_dataBytes;
+  if( ringOffset + entry.length() > m_dataBytes )
+  {
+    position += m_dataBytes - ringOffset;
+  }
+
+  bool fEvicted = false;
+  while( m_state.m_count == capacity ||
+         ( m_state.m_count > 0 && position + entry.length() - m_pSlots[ oldestSlot() ].m_position > m_dataBytes ) )
+  {
+    evictOldest();
+    fEvicted = true;
+  }
+  if( fEvicted )
+  {
+    // the evicted entries' bytes and slots are about to be reused; make sure no committed state
+    // still points at them.
+    commit();
+  }
+
+  memcpy( m_pData + position % m_dataBytes, entry.data(), entry.length() );
+  PersistentSlot& slot = m_pSlots[ m_state.m_insertPoint ];
+  slot.m_position = position;
+  slot.m_length = entry.length();
+
+  m_state.m_dataTail = position + entry.length();
+  m_state.m_insertPoint = m_state.m_insertPoint + 1 == capacity ? 0 : m_state.m_insertPoint + 1;
+  m_state.m_count++;
+}
+
+void PersistentCircularBuffer::append( const std::vector<StringRef>& list )
+{
+  if( list.empty() )
+  {
+    return;
+  }
+  m_listing.invalidate();
+  for( std::vector<StringRef>::const_iterator i = list.begin(); i != list.end(); ++i )
+  {
+    appendOne( *i );
+  }
+  // one commit publishes the whole batch.
+  commit();
+}
+
+void PersistentCircularBuffer::remove( const unsigned count )
+{
+  if( count == 0 )
+  {
+    return;
+  }
+  m_listing.invalidate();
+  m_state.m_count -= std::min( count, m_state.m_count );
+  commit();
+}
+
+void PersistentCircularBuffer::showList( void )
+{
+  if( !m_listing.isCurrent() )
+  {
+    m_listing.reset();
+    const unsigned capacity = m_pHeader->m_capacity;
+    unsigned slot = oldestSlot();
+    for( unsigned i = 0; i < m_state.m_count; ++i )
+    {
+      m_listing.add( StringRef( m_pData + m_pSlots[ slot ].m_position % m_dataBytes, m_pSlots[ slot ].m_length ) );
+      if( ++slot == capacity )
+        slot = 0;
+    }
+  }
+  m_listing.show();
+}
@@ -0,0 +1,101 @@
+// persistent-circular-buffer.h: CircularBuffer that lives in a memory-mapped file, so a restarted
+//  cbuf picks up where the last one stopped instead of starting empty.
+//
+//  file layout:
+//    header   magic, version, capacity (N), data bytes, and two copies of the buffer state
+//             (generation, insert point, count, data tail, checksum)
+//    slots    N x (data position, length)
+//    data     a byte ring holding the entry bytes; an entry never wraps, if it doesn't fit before
+//             the end of the ring the rest of the ring is skipped
+//
+//  the state is only ever changed by writing the copy that is not current, checksum last, with a
+//  generation one higher than the current one; reattaching picks the valid copy with the highest
+//  generation, which takes O(1) no matter how much is buffered. entry bytes and slots are written
+//  before the state that makes them visible, and entries are evicted (in a committed state) before
+//  their bytes or slot are reused, so a crash at any point leaves the last committed state intact:
+//  an entry is either fully there or not there at all. a file that doesn't add up anyway (a
+//  different size than its header says, or a live slot outside the data ring or the committed
+//  data) is not trusted and gets formatted again.
+//
+//  this protects against the process dying. surviving power loss would additionally need msync
+//  before each state commit, which is not done.
+#ifndef PERSISTENT_CIRCULAR_BUFFER_H
+#define PERSISTENT_CIRCULAR_BUFFER_H
+
+#include <string>
+#include <stdint.h>
+
+#include "circular-buffer.h"
+#include "output-sink.h"
+
+struct PersistentState
+{
+  uint64_t m_generation;
+  uint64_t m_dataTail;     // free-running byte position just past the newest entry
+  uint32_t m_insertPoint;  // next slot
+  uint32_t m_count;
+  uint64_t m_checksum;     // over the fields above, 0 never matches a written state
+};
+
+struct PersistentHeader
+{
+  uint64_t        m_magic;
+  uint32_t        m_version;
+  uint32_t        m_capacity;
+  uint64_t        m_dataBytes;
+  PersistentState m_state[ 2 ];
+};
+
+struct PersistentSlot
+{
+  uint64_t m_position;  // free-running byte position of the entry in the data ring
+  uint32_t m_length;
+  uint32_t m_reserved;
+};
+
+class PersistentCircularBuffer : public CircularBuffer
+{
+  const std::string m_path;
+  size_t            m_dataBytes;  // taken from the file when reattaching
+  int               m_fd;
+
+  char*             m_pMap;
+  size_t            m_mapLength;
+  PersistentHeader* m_pHeader;
+  PersistentSlot*   m_pSlots;
+  char*             m_pData;
+
+  PersistentState   m_state;  // working copy, written out by commit()
+  ListingSink       m_listing;
+
+  PersistentCircularBuffer( const std::string& _path, const size_t _dataBytes, const int _fd );
+
+  // not copyable, we own the mapping.
+  PersistentCircularBuffer( const PersistentCircularBuffer& );
+  PersistentCircularBuffer& operator=( const PersistentCircularBuffer& );
+
+  static uint64_t checksumOf( const PersistentState& state );
+
+  bool mapFile( const unsigned capacity );
+  bool reattach( const unsigned capacity );
+  bool slotsValid( void ) const;
+  void format( const unsigned capacity );
+  void commit( void );
+
+  unsigned oldestSlot( void ) const;
+  void     evictOldest( void );
+  void     appendOne( const StringRef& entry );
+
+public:
+  ~PersistentCircularBuffer();
+
+  // opens (creating if needed) the backing file. returns 0 if it can't be opened.
+  static PersistentCircularBuffer* open( const std::string& path, const size_t dataBytes );
+
+  void setSize( const unsigned size );
+  void append( const std::vector<StringRef>& list );
+  void remove( const unsigned count );
+  void showList( void );
+};
+
+#endif // PERSISTENT_CIRCULAR_BUFFER_H
@@ -0,0 +1,153 @@
+// reader-cursor.cpp: ReaderCursor and CursorCircularBuffer implementation (see reader-cursor.h)
+#include "reader-cursor.h"
+
+#include <algorithm>
+#include <cstdio>  // snprintf
+#include <sys/uio.h>
+
+#include "output-sink.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ReaderCursor
+
+ReaderCursor::ReaderCursor( const CursorCircularBuffer& _cb ) :
+  m_pCb( &_cb ),
+  m_position( _cb.endSequence() - _cb.keptCount() ),
+  m_overrunCount( 0 )
+{
+}
+
+EntrySpans ReaderCursor::read( const unsigned k, /*out*/ uint64_t& lostCount )
+{
+  // the writer got past us: skip to the oldest entry still kept.
+  const uint64_t oldest = m_pCb->endSequence() - m_pCb->keptCount();
+  lostCount = 0;
+  if( m_position < oldest )
+  {
+    lostCount = oldest - m_position;
+    m_overrunCount += lostCount;
+    m_position = oldest;
+  }
+
+  const unsigned count = std::min<uint64_t>( k, m_pCb->endSequence() - m_position );
+  const EntrySpans spans = m_pCb->readKept( m_position, count );
+  m_position += count;
+  return spans;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CursorCircularBuffer
+
+CursorCircularBuffer::CursorCircularBuffer( CircularBuffer* inner ) :
+  m_pInner( inner ),
+  m_maxSize( 0 ),
+  m_insertSlot( 0 ),
+  m_keptCount( 0 ),
+  m_endSequence( 0 ),
+  m_slots(),
+  m_cursors()
+{
+}
+
+void CursorCircularBuffer::setSize( const unsigned size )
+{
+  m_pInner->setSize( size );
+  m_maxSize = size;
+  m_slots.resize( size );
+}
+
+void CursorCircularBuffer::append( const std::vector<StringRef>& list )
+{
+  m_pInner->append( list );
+  m_endSequence += list.size();
+  if( m_maxSize == 0 )
+  {
+    return;
+  }
+  for( std::vector<StringRef>::const_iterator i = list.begin(); i != list.end(); ++i )
+  {
+    m_slots[ m_insertSlot ] = *i;
+    m_insertSlot = m_insertSlot + 1 == m_maxSize ? 0 : m_insertSlot + 1;
+  }
+  m_keptCount = std::min<uint64_t>( m_keptCount + list.size(), m_maxSize );
+}
+
+void CursorCircularBuffer::remove( const unsigned count )
+{
+  // cursors read what was appended, remove only changes the listing.
+  m_pInner->remove( count );
+}
+
+void CursorCircularBuffer::showList( void )
+{
+  m_pInner->showList();
+}
+
+void CursorCircularBuffer::showPositions( const StringRef& content )
+{
+  m_pInner->showPositions( content );
+}
+
+void CursorCircularBuffer::skip( const unsigned count )
+{
+  // the parser only skips lines when an append is longer than the buffer, and then the lines it
+  // keeps overwrite everything that was there before.
+  m_endSequence += count;
+  m_keptCount = 0;
+}
+
+EntrySpans CursorCircularBuffer::readKept( const uint64_t sequence, const unsigned count ) const
+{
+  EntrySpans spans;
+  if( count == 0 )
+  {
+    return spans;
+  }
+  // the oldest kept entry sits m_keptCount slots behind the insert point.
+  const unsigned back = m_endSequence - sequence;
+  const unsigned start = m_insertSlot >= back ? m_insertSlot - back : m_insertSlot + m_maxSize - back;
+  spans.m_first = &m_slots[ start ];
+  spans.m_firstCount = std::min( count, m_maxSize - start );
+  spans.m_second = &m_slots[ 0 ];
+  spans.m_secondCount = count - spans.m_firstCount;
+  return spans;
+}
+
+void CursorCircularBuffer::showNext( const unsigned cursor, const unsigned count )
+{
+  CursorMap::iterator it = m_cursors.find( cursor );
+  if( it == m_cursors.end() )
+  {
+    it = m_cursors.insert( std::make_pair( cursor, ReaderCursor( *this ) ) ).first;
+  }
+  uint64_t lostCount = 0;
+  const EntrySpans spans = it->second.read( count, lostCount );
+
+  // the header, then every entry straight from its slot.
+  char header[ 48 ];
+  const int headerLength = snprintf( header, sizeof( header ), "%zu %llu\n", spans.size(), static_cast<unsigned long long>( lostCount ) );
+  static char newline = '\n';
+  std::vector<struct iovec> iov;
+  iov.reserve( 1 + 2 * spans.size() );
+  struct iovec span;
+  span.iov_base = header;
+  span.iov_len = headerLength;
+  iov.push_back( span );
+  for( size_t i = 0; i < spans.size(); ++i )
+  {
+    span.iov_base = const_cast<char*>( spans[ i ].data() );
+    span.iov_len = spans[ i ].length();
+    iov.push_back( span );
+    span.iov_base = &newline;
+    span.iov_len = 1;
+    iov.push_back( span );
+  }
+  // writev takes at most IOV_MAX spans at a time.
+  for( size_t done = 0; done < iov.size(); )
+  {
+    const size_t batch = std::min<size_t>( iov.size() - done, 1024 );
+    writeAllToStdout( &iov[ done ], batch );
+    done += batch;
+  }
+}
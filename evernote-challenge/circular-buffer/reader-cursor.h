@@ -0,0 +1,101 @@
+// reader-cursor.h: independent read positions on a CircularBuffer, for consumers that each need
+//  to see every appended entry at their own pace ("cbuf -cursors").
+//
+//  CursorCircularBuffer is a decorator that numbers every appended line and keeps the last N of
+//  them, whatever remove does to the L listing. a ReaderCursor is just a sequence number into
+//  that. the writer never looks at cursors, so a slow reader can't hold it up; if the writer laps
+//  a cursor, the entries it lost are counted as overrun and the cursor resumes at the oldest entry
+//  still kept. entries are read in place, as views of the kept slots: nothing is copied.
+//
+//  the command is "N c k": print the next (up to) k entries for cursor c, after a line with how
+//  many follow and how many the cursor lost since its last read. a cursor is opened at the oldest
+//  kept entry the first time it's read ("N c 0" just opens it).
+#ifndef READER_CURSOR_H
+#define READER_CURSOR_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "circular-buffer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// EntrySpans: consecutive entries read in place from a ring of slots. the slots wrap, so that's
+//  at most two contiguous runs.
+
+struct EntrySpans
+{
+  const StringRef* m_first;
+  size_t           m_firstCount;
+  const StringRef* m_second;
+  size_t           m_secondCount;
+
+  EntrySpans() : m_first( 0 ), m_firstCount( 0 ), m_second( 0 ), m_secondCount( 0 ) {}
+
+  size_t size( void ) const { return m_firstCount + m_secondCount; }
+
+  const StringRef& operator[]( const size_t i ) const { return i < m_firstCount ? m_first[ i ] : m_second[ i - m_firstCount ]; }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CursorCircularBuffer
+
+class CursorCircularBuffer;
+
+class ReaderCursor
+{
+  const CursorCircularBuffer* m_pCb;
+  uint64_t                    m_position;      // sequence number of the next entry to read
+  uint64_t                    m_overrunCount;  // total entries overwritten before this cursor read them
+
+public:
+  // starts at the oldest entry kept now.
+  ReaderCursor( const CursorCircularBuffer& _cb );
+
+  uint64_t position( void ) const { return m_position; }
+  uint64_t overrunCount( void ) const { return m_overrunCount; }
+
+  // the next (up to) k entries, in place. lostCount is how many entries the writer overwrote
+  // before this cursor got to them, since its last read. the spans stay valid until the buffer is
+  // next appended to.
+  EntrySpans read( const unsigned k, /*out*/ uint64_t& lostCount );
+};
+
+///////////////
+
+class CursorCircularBuffer : public CircularBuffer
+{
+  typedef std::map<unsigned, ReaderCursor> CursorMap;
+
+  std::auto_ptr<CircularBuffer> m_pInner;
+
+  unsigned               m_maxSize;
+  unsigned               m_insertSlot;
+  unsigned               m_keptCount;    // like the inner buffer's entry count, but without removes
+  uint64_t               m_endSequence;  // sequence number the next appended line gets
+  std::vector<StringRef> m_slots;
+  CursorMap              m_cursors;
+
+public:
+  // takes ownership of inner, which does the actual storing and listing.
+  CursorCircularBuffer( CircularBuffer* inner );
+
+  void setSize( const unsigned size );
+  void append( const std::vector<StringRef>& list );
+  void remove( const unsigned count );
+  void showList( void );
+  void showPositions( const StringRef& content );
+  void skip( const unsigned count );
+  void showNext( const unsigned cursor, const unsigned count );
+
+  // the kept entries are sequence numbers [ endSequence() - keptCount(), endSequence() ).
+  uint64_t endSequence( void ) const { return m_endSequence; }
+  unsigned keptCount( void ) const { return m_keptCount; }
+
+  // count kept entries starting at sequence.
+  EntrySpans readKept( const uint64_t sequence, const unsigned count ) const;
+};
+
+#endif // READER_CURSOR_H
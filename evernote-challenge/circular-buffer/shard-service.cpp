@@ -0,0 +1,521 @@
+// shard-service.cpp: named buffers hash-sharded over worker threads (see shard-service.h)
+#include "shard-service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>    // tolower, isspace, isdigit
+#include <cstring>   // memchr, memcpy
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>  // iovec
+
+#include "string-ref.h"
+#include "content-index.h"  // StringRefHash, StringRefEqual
+#include "output-sink.h"
+#include "spsc-circular-buffer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ShardCommand and OutputChunk: what travels between the threads
+
+enum ShardCommandType
+{
+  kShardAppend,
+  kShardRemove,
+  kShardList,
+  kShardQuit,
+};
+
+struct ShardCommand
+{
+  ShardCommandType m_type;
+  StringRef        m_key;
+  StringRef        m_lines;     // append only: the surviving lines, still '\n'-separated in the input
+  unsigned         m_count;     // append: lines in m_lines, remove: entries to remove
+  uint64_t         m_sequence;  // list only: position of its output among all the listings
+};
+
+struct OutputChunk
+{
+  uint64_t          m_sequence;
+  std::vector<char> m_bytes;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// NamedBuffer: one buffer of the service. entries are views into the input like in a
+//  SlotCircularBuffer, but the slot ring only grows as entries arrive, so thousands of mostly
+//  small buffers don't each pay for N slots up front.
+//
+//  reading a stream, the entries are views of copies instead: with thousands of buffers there's
+//  no telling cheaply which of them still point where, so the input is only kept until the shard
+//  has performed the command (see runShardService). each slot keeps its copy's capacity, so a
+//  full ring stops allocating.
+
+class NamedBuffer
+{
+  std::vector<StringRef>          m_slots;
+  std::vector< std::vector<char> > m_copies;  // parallel to m_slots, if fCopy
+  bool                            m_fCopy;
+  unsigned                        m_maxSize;
+  unsigned                        m_head;  // slot of the oldest entry
+  unsigned                        m_itemCount;
+
+  unsigned slotAfter( const unsigned slot, const unsigned offset ) const
+  {
+    const unsigned result = slot + offset;
+    return result >= m_slots.size() ? result - m_slots.size() : result;
+  }
+
+  void grow( void );
+  void store( const unsigned slot, const StringRef& entry );
+
+public:
+  NamedBuffer( const unsigned _maxSize, const bool _fCopy ) :
+    m_slots(), m_copies(), m_fCopy( _fCopy ), m_maxSize( _maxSize ), m_head( 0 ), m_itemCount( 0 ) {}
+
+  void append( const StringRef& entry );
+  void remove( unsigned count );
+  void render( /*out*/ std::vector<char>& out ) const;
+};
+
+void NamedBuffer::grow( void )
+{
+  // unroll into a bigger ring with the oldest entry at slot 0.
+  // the copies move along with their views, which stay good: swapping vectors keeps their bytes.
+  const size_t size = std::min<size_t>( std::max<size_t>( m_slots.size() * 2, 8 ), m_maxSize );
+  std::vector<StringRef> bigger( size );
+  std::vector< std::vector<char> > biggerCopies( m_fCopy ? size : 0 );
+  for( unsigned i = 0; i < m_itemCount; ++i )
+  {
+    bigger[ i ] = m_slots[ slotAfter( m_head, i ) ];
+    if( m_fCopy )
+      biggerCopies[ i ].swap( m_copies[ slotAfter( m_head, i ) ] );
+  }
+  m_slots.swap( bigger );
+  m_copies.swap( biggerCopies );
+  m_head = 0;
+}
+
+void NamedBuffer::store( const unsigned slot, const StringRef& entry )
+{
+  if( !m_fCopy )
+  {
+    m_slots[ slot ] = entry;
+    return;
+  }
+  std::vector<char>& copy = m_copies[ slot ];
+  copy.assign( entry.data(), entry.data() + entry.length() );
+  m_slots[ slot ] = StringRef( copy.data(), copy.size() );
+}
+
+void NamedBuffer::append( const StringRef& entry )
+{
+  if( m_maxSize == 0 )
+    return;
+  if( m_itemCount == m_slots.size() && m_slots.size() < m_maxSize )
+    grow();
+
+  if( m_itemCount == m_maxSize )
+  {
+    // full, overwrite the oldest
+    store( m_head, entry );
+    m_head = slotAfter( m_head, 1 );
+    return;
+  }
+  store( slotAfter( m_head, m_itemCount ), entry );
+  ++m_itemCount;
+}
+
+void NamedBuffer::remove( unsigned count )
+{
+  count = std::min( count, m_itemCount );
+  if( count == 0 )
+    return;
+  m_head = slotAfter( m_head, count );
+  m_itemCount -= count;
+}
+
+void NamedBuffer::render( /*out*/ std::vector<char>& out ) const
+{
+  for( unsigned i = 0; i < m_itemCount; ++i )
+  {
+    const StringRef& entry = m_slots[ slotAfter( m_head, i ) ];
+    const size_t used = out.size();
+    out.resize( used + entry.length() + 1 );
+    memcpy( &out[ used ], entry.data(), entry.length() );
+    out[ used + entry.length() ] = '\n';
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shard: a worker thread and the buffers it owns. only the shard's own thread ever touches
+//  m_buffers; the two queues are its only contact with the rest of the process.
+
+class Shard
+{
+  typedef std::unordered_map<StringRef, NamedBuffer, StringRefHash, StringRefEqual> BufferMap;
+
+  const unsigned          m_bufferSize;
+  const bool              m_fCopyEntries;
+  BufferMap               m_buffers;  // keyed by views of m_names
+  std::deque<std::string> m_names;    // copies of the keys, they never move
+  IdleWaiter&             m_outputWaiter;  // the writer's, shared by every shard
+
+  void perform( const ShardCommand& cmd );
+  void sendOutput( OutputChunk* pChunk );
+
+  // not copyable, the queues are shared with other threads.
+  Shard( const Shard& );
+  Shard& operator=( const Shard& );
+
+public:
+  static const size_t kCommandQueueSize = 1024;
+  static const size_t kOutputQueueSize = 256;
+
+  SpscCircularBuffer<ShardCommand> m_commands;  // from the parser, who notifies m_commandsWaiter
+  SpscCircularBuffer<OutputChunk*> m_output;    // to the writer, a null chunk means the shard is done
+  IdleWaiter                       m_commandsWaiter;
+  std::atomic<uint64_t>            m_performedCount;  // commands done with their input, for the parser
+
+  Shard( const unsigned _bufferSize, const bool _fCopyEntries, IdleWaiter& _outputWaiter ) :
+    m_bufferSize( _bufferSize ),
+    m_fCopyEntries( _fCopyEntries ),
+    m_buffers(),
+    m_names(),
+    m_outputWaiter( _outputWaiter ),
+    m_commands( kCommandQueueSize ),
+    m_output( kOutputQueueSize ),
+    m_commandsWaiter(),
+    m_performedCount( 0 )
+  { }
+
+  void run( void );
+};
+
+void Shard::sendOutput( OutputChunk* pChunk )
+{
+  // a full queue means the writer is busy, not idle: it'll be back soon.
+  while( m_output.tryAppend( &pChunk, 1 ) == 0 )
+    std::this_thread::yield();
+  m_outputWaiter.notify();
+}
+
+void Shard::perform( const ShardCommand& cmd )
+{
+  switch( cmd.m_type )
+  {
+  case kShardAppend:
+  {
+    BufferMap::iterator it = m_buffers.find( cmd.m_key );
+    if( it == m_buffers.end() )
+    {
+      m_names.push_back( std::string( cmd.m_key.data(), cmd.m_key.length() ) );
+      it = m_buffers.insert( BufferMap::value_type( StringRef( m_names.back().data(), m_names.back().length() ), NamedBuffer( m_bufferSize, m_fCopyEntries ) ) ).first;
+    }
+
+    const char* p = cmd.m_lines.data();
+    const char* end = p + cmd.m_lines.length();
+    for( unsigned i = 0; i < cmd.m_count; ++i )
+    {
+      const char* newline = static_cast<const char*>( memchr( p, '\n', end - p ) );
+      const char* lineEnd = newline ? newline : end;
+      it->second.append( StringRef( p, lineEnd - p ) );
+      p = newline ? newline + 1 : end;
+    }
+    break;
+  }
+  case kShardRemove:
+  {
+    BufferMap::iterator it = m_buffers.find( cmd.m_key );
+    if( it != m_buffers.end() )
+      it->second.remove( cmd.m_count );
+    break;
+  }
+  case kShardList:
+  {
+    // listing a buffer that was never named is fine, it's just empty.
+    OutputChunk* pChunk = new OutputChunk();
+    pChunk->m_sequence = cmd.m_sequence;
+    BufferMap::const_iterator it = m_buffers.find( cmd.m_key );
+    if( it != m_buffers.end() )
+      it->second.render( pChunk->m_bytes );
+    sendOutput( pChunk );
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void Shard::run( void )
+{
+  std::vector<ShardCommand> batch;
+  batch.reserve( kCommandQueueSize );
+  for( ;; )
+  {
+    batch.clear();
+    if( m_commands.drain( batch, kCommandQueueSize ) == 0 )
+    {
+      m_commandsWaiter.wait( [this]() { return m_commands.size() > 0; } );
+      continue;
+    }
+    for( std::vector<ShardCommand>::const_iterator it = batch.begin(); it != batch.end(); ++it )
+    {
+      if( it->m_type == kShardQuit )
+      {
+        sendOutput( 0 );
+        return;
+      }
+      perform( *it );
+    }
+    // the release pairs with the parser's acquire in releasePerformed.
+    m_performedCount.fetch_add( batch.size(), std::memory_order_release );
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// writer: collects listings from every shard and writes them out in input order
+
+static void writeInOrder( const std::vector<Shard*>& shards, IdleWaiter& outputWaiter )
+{
+  const size_t kMaxSpans = 256;
+
+  std::map<uint64_t, OutputChunk*> pending;  // arrived ahead of their turn
+  uint64_t nextSequence = 0;
+  size_t runningShards = shards.size();
+  std::vector<OutputChunk*> arrived;
+  std::vector<OutputChunk*> written;
+  std::vector<struct iovec> spans;
+  spans.reserve( kMaxSpans );
+
+  while( runningShards > 0 || !pending.empty() )
+  {
+    arrived.clear();
+    for( std::vector<Shard*>::const_iterator it = shards.begin(); it != shards.end(); ++it )
+      ( *it )->m_output.drain( arrived, Shard::kOutputQueueSize );
+    for( std::vector<OutputChunk*>::const_iterator it = arrived.begin(); it != arrived.end(); ++it )
+    {
+      if( *it )
+        pending[ ( *it )->m_sequence ] = *it;
+      else
+        --runningShards;
+    }
+
+    // everything that's now next in line goes out in one writev.
+    spans.clear();
+    written.clear();
+    std::map<uint64_t, OutputChunk*>::iterator next = pending.begin();
+    while( next != pending.end() && next->first == nextSequence && spans.size() < kMaxSpans )
+    {
+      OutputChunk* pChunk = next->second;
+      if( !pChunk->m_bytes.empty() )
+      {
+        struct iovec span;
+        span.iov_base = &pChunk->m_bytes[ 0 ];
+        span.iov_len = pChunk->m_bytes.size();
+        spans.push_back( span );
+      }
+      written.push_back( pChunk );
+      pending.erase( next++ );
+      ++nextSequence;
+    }
+    if( !spans.empty() )
+      writeAllToStdout( &spans[ 0 ], spans.size() );
+    for( std::vector<OutputChunk*>::const_iterator it = written.begin(); it != written.end(); ++it )
+      delete *it;
+
+    if( arrived.empty() && written.empty() )
+    {
+      outputWaiter.wait( [&shards]()
+      {
+        for( std::vector<Shard*>::const_iterator it = shards.begin(); it != shards.end(); ++it )
+        {
+          if( ( *it )->m_output.size() > 0 )
+            return true;
+        }
+        return false;
+      } );
+    }
+  }
+}
+
+// the parser notes where it was every so often, and how many commands it had given each shard
+// by then. once every shard has performed that many, nothing points into the input before it.
+struct InputCheckpoint
+{
+  const char*           m_position;
+  std::vector<uint64_t> m_assigned;  // by shard
+};
+
+static void releasePerformed( InputSource& input, const std::vector<Shard*>& shards, /*in,out*/ std::deque<InputCheckpoint>& checkpoints )
+{
+  const char* keep = 0;
+  while( !checkpoints.empty() )
+  {
+    const InputCheckpoint& oldest = checkpoints.front();
+    for( size_t i = 0; i < shards.size(); ++i )
+    {
+      if( shards[ i ]->m_performedCount.load( std::memory_order_acquire ) < oldest.m_assigned[ i ] )
+      {
+        if( keep )
+          input.release( keep );
+        return;
+      }
+    }
+    keep = oldest.m_position;
+    checkpoints.pop_front();
+  }
+  if( keep )
+    input.release( keep );
+}
+
+// hands shard its routed commands so far.
+static void routeBatch( Shard& shard, /*in,out*/ std::vector<ShardCommand>& batch )
+{
+  if( batch.empty() )
+    return;
+  shard.m_commands.append( batch );
+  shard.m_commandsWaiter.notify();
+  batch.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// parser: runs on the calling thread and routes each command to the shard owning its key
+
+// atoi-alike on [p, end).
+static unsigned parseCount( const char* p, const char* end )
+{
+  while( p != end && isspace( *p ) )
+    ++p;
+  unsigned result = 0;
+  for( ; p != end && isdigit( *p ); ++p )
+    result = result * 10 + ( *p - '0' );
+  return result;
+}
+
+// splits the arguments of "A key 12" into key and count (0 if missing).
+static void parseKeyedArgs( const StringRef& line, /*out*/ StringRef& key, /*out*/ unsigned& count )
+{
+  const char* p = line.data() + std::min<size_t>( 1, line.length() );
+  const char* end = line.data() + line.length();
+  while( p != end && isspace( *p ) )
+    ++p;
+  const char* keyStart = p;
+  while( p != end && !isspace( *p ) )
+    ++p;
+  key = StringRef( keyStart, p - keyStart );
+  count = parseCount( p, end );
+}
+
+void runShardService( InputSource& input, unsigned shardCount )
+{
+  // commands are handed over in batches of this many per shard, to keep queue traffic down.
+  const size_t kRouteBatch = 64;
+  // and the input is checked for what can be released every this many commands.
+  const size_t kCheckpointCommands = 256;
+
+  if( shardCount == 0 )
+    shardCount = std::max( std::thread::hardware_concurrency(), 1u );
+
+  LineReader reader( input );
+  const StringRef sizeLine = reader.getLine();
+  const unsigned bufferSize = parseCount( sizeLine.data(), sizeLine.data() + sizeLine.length() );
+
+  IdleWaiter outputWaiter;
+  std::vector<Shard*> shards;
+  std::vector<std::thread> workers;
+  for( unsigned i = 0; i < shardCount; ++i )
+  {
+    shards.push_back( new Shard( bufferSize, !input.keepsAll(), outputWaiter ) );
+    workers.push_back( std::thread( &Shard::run, shards.back() ) );
+  }
+  std::thread writer( writeInOrder, std::cref( shards ), std::ref( outputWaiter ) );
+
+  std::vector< std::vector<ShardCommand> > routed( shardCount );
+  std::vector<uint64_t> assigned( shardCount, 0 );
+  std::deque<InputCheckpoint> checkpoints;
+  size_t sinceCheckpoint = 0;
+  const StringRefHash hash;
+  uint64_t listCount = 0;
+  bool fDone = false;
+  while( !fDone )
+  {
+    // about to wait for input: whatever's routed so far goes out first.
+    if( !reader.lineBuffered() )
+    {
+      for( unsigned i = 0; i < shardCount; ++i )
+        routeBatch( *shards[ i ], routed[ i ] );
+    }
+
+    const StringRef line = reader.getLine();
+    ShardCommand cmd;
+    cmd.m_sequence = 0;
+    parseKeyedArgs( line, cmd.m_key, cmd.m_count );
+
+    const char firstChar = line.empty() ? '\0' : tolower( line.data()[ 0 ] );
+    switch( firstChar )
+    {
+    case 'a':
+    {
+      // as in InputParser, only the last N lines of an append can survive it.
+      const unsigned keepCount = std::min( cmd.m_count, bufferSize );
+      reader.skipLines( cmd.m_count - keepCount );
+      cmd.m_type = kShardAppend;
+      cmd.m_lines = reader.getLines( keepCount );
+      cmd.m_count = keepCount;
+      break;
+    }
+    case 'r':
+      cmd.m_type = kShardRemove;
+      break;
+    case 'l':
+      cmd.m_type = kShardList;
+      cmd.m_sequence = listCount++;
+      break;
+    default:
+      fDone = true;
+      continue;
+    }
+
+    const size_t shard = hash( cmd.m_key ) % shardCount;
+    std::vector<ShardCommand>& batch = routed[ shard ];
+    batch.push_back( cmd );
+    ++assigned[ shard ];
+    if( batch.size() >= kRouteBatch )
+      routeBatch( *shards[ shard ], batch );
+
+    if( ++sinceCheckpoint == kCheckpointCommands )
+    {
+      sinceCheckpoint = 0;
+      InputCheckpoint checkpoint;
+      checkpoint.m_position = reader.position();
+      checkpoint.m_assigned = assigned;
+      checkpoints.push_back( checkpoint );
+      releasePerformed( input, shards, checkpoints );
+    }
+  }
+
+  for( unsigned i = 0; i < shardCount; ++i )
+  {
+    ShardCommand quit;
+    quit.m_type = kShardQuit;
+    quit.m_count = 0;
+    quit.m_sequence = 0;
+    routed[ i ].push_back( quit );
+    routeBatch( *shards[ i ], routed[ i ] );
+  }
+
+  for( unsigned i = 0; i < shardCount; ++i )
+    workers[ i ].join();
+  writer.join();
+  for( unsigned i = 0; i < shardCount; ++i )
+    delete shards[ i ];
+}
@@ -0,0 +1,28 @@
+// shard-service.h: "cbuf -shards <k>" runs many independent named buffers in one process.
+//  every command names the buffer it applies to:
+//
+//    N            first line, the size of every named buffer
+//    A key n      followed by n lines, append them to buffer key
+//    R key n      remove the n oldest entries of buffer key
+//    L key        list buffer key, oldest first
+//    Q            quit
+//
+//  a buffer comes into existence (empty) the first time it's named. keys are hashed onto k worker
+//  threads ("shards"); each shard owns its buffers outright, so buffer work takes no locks. the
+//  parser routes commands to shards over per-shard SpscCircularBuffers, and the shards hand
+//  rendered listings to a writer thread that puts them on stdout in input order, so the output
+//  is the same whatever k is. routed commands are batched up, but every batch goes out before the
+//  parser waits for more input, so an L is answered as soon as it's in. threads with nothing to
+//  do sleep (see IdleWaiter). reading a stream, buffers keep copies of their entries, so the
+//  input only has to be kept (see InputSource::release) until every shard has performed the
+//  commands in it.
+#ifndef SHARD_SERVICE_H
+#define SHARD_SERVICE_H
+
+#include "input-source.h"
+
+// runs the keyed commands in input up to the Q (or the first bad command). shardCount == 0
+// means one shard per hardware thread.
+void runShardService( InputSource& input, unsigned shardCount );
+
+#endif // SHARD_SERVICE_H
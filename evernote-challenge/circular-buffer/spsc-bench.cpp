@@ -0,0 +1,140 @@
+// spsc-bench.cpp: throughput of SpscCircularBuffer vs. a mutex-wrapped ring, one producer thread
+//  handing entries to one consumer thread.
+//  usage: spsc-bench [entryCount] [capacity] [batchSize]
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdlib>   // strtoul
+
+#include "spsc-circular-buffer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MutexCircularBuffer: same bounded, non-overwriting contract as SpscCircularBuffer, one lock.
+
+template<typename T>
+class MutexCircularBuffer
+{
+  std::mutex     m_mutex;
+  std::vector<T> m_slots;
+  size_t         m_head;
+  size_t         m_count;
+
+public:
+  MutexCircularBuffer( const size_t capacity ) : m_slots( capacity ), m_head( 0 ), m_count( 0 ) {}
+
+  size_t tryAppend( const T* items, const size_t count )
+  {
+    std::lock_guard<std::mutex> lock( m_mutex );
+    const size_t appendCount = std::min( m_slots.size() - m_count, count );
+    for( size_t i = 0; i < appendCount; ++i )
+    {
+      m_slots[ ( m_head + m_count + i ) % m_slots.size() ] = items[ i ];
+    }
+    m_count += appendCount;
+    return appendCount;
+  }
+
+  size_t drain( std::vector<T>& out, const size_t maxCount )
+  {
+    std::lock_guard<std::mutex> lock( m_mutex );
+    const size_t drainCount = std::min( m_count, maxCount );
+    for( size_t i = 0; i < drainCount; ++i )
+    {
+      out.push_back( m_slots[ ( m_head + i ) % m_slots.size() ] );
+    }
+    m_head = ( m_head + drainCount ) % m_slots.size();
+    m_count -= drainCount;
+    return drainCount;
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// benchmark driver
+
+// pushes 0..entryCount-1 through buf in batches, checks they come out in order. returns seconds.
+template<typename Buffer>
+static double runHandoff( Buffer& buf, const size_t entryCount, const size_t batchSize, /*out*/ bool& fOk )
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::thread producer( [&buf, entryCount, batchSize]()
+  {
+    std::vector<size_t> batch( batchSize );
+    size_t next = 0;
+    while( next < entryCount )
+    {
+      const size_t thisBatch = std::min( batchSize, entryCount - next );
+      for( size_t i = 0; i < thisBatch; ++i )
+        batch[ i ] = next + i;
+      size_t done = 0;
+      while( done < thisBatch )
+      {
+        const size_t appended = buf.tryAppend( &batch[ done ], thisBatch - done );
+        done += appended;
+        if( appended == 0 )
+          std::this_thread::yield();
+      }
+      next += thisBatch;
+    }
+  } );
+
+  fOk = true;
+  std::vector<size_t> out;
+  out.reserve( batchSize );
+  size_t expected = 0;
+  while( expected < entryCount )
+  {
+    out.clear();
+    if( buf.drain( out, batchSize ) == 0 )
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    for( std::vector<size_t>::const_iterator it = out.begin(); it != out.end(); ++it )
+    {
+      fOk = fOk && ( *it == expected );
+      ++expected;
+    }
+  }
+  producer.join();
+
+  return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+static void report( const char* name, const size_t entryCount, const double seconds, const bool fOk )
+{
+  std::cout << name << ": " << entryCount / seconds / 1e6 << " M entries/s (" << seconds << " s)"
+            << ( fOk ? "" : "  ** ORDER MISMATCH **" ) << std::endl;
+}
+
+int main( int argc, char **argv )
+{
+  const size_t entryCount = argc > 1 ? strtoul( argv[ 1 ], 0, 10 ) : 20000000;
+  const size_t capacity   = argc > 2 ? strtoul( argv[ 2 ], 0, 10 ) : 10000;
+  const size_t batchSize  = argc > 3 ? strtoul( argv[ 3 ], 0, 10 ) : 64;
+  if( capacity == 0 || batchSize == 0 )
+  {
+    std::cerr << "usage: spsc-bench [entryCount] [capacity > 0] [batchSize > 0]" << std::endl;
+    return 1;
+  }
+
+  std::cout << "entries " << entryCount << ", capacity " << capacity << ", batch " << batchSize
+            << ", hardware threads " << std::thread::hardware_concurrency() << std::endl;
+
+  bool fOk = false;
+  {
+    MutexCircularBuffer<size_t> buf( capacity );
+    const double seconds = runHandoff( buf, entryCount, batchSize, fOk );
+    report( "mutex", entryCount, seconds, fOk );
+  }
+  {
+    SpscCircularBuffer<size_t> buf( capacity );
+    const double seconds = runHandoff( buf, entryCount, batchSize, fOk );
+    report( "spsc ", entryCount, seconds, fOk );
+  }
+
+  return 0;
+}
@@ -0,0 +1,238 @@
+// spsc-circular-buffer.h: lock-free single-producer/single-consumer circular buffer, for handing
+//  entries from an ingest thread to a writer thread without a mutex.
+//
+//  one thread calls append/tryAppend, one other thread calls pop/drain/remove. the two sides share
+//  nothing but m_tail (written by the producer) and m_head (written by the consumer), each on its
+//  own cache line. each side also keeps a private copy of the other side's index and only re-reads
+//  the shared one when the copy says it is out of room/entries, so in steady state the two cache
+//  lines only move between cores once per batch rather than once per entry.
+//
+//  unlike SlotCircularBuffer the producer never overwrites unconsumed entries: that would mean
+//  writing m_head (or slots the consumer may be reading) from the producer side. when the ring is
+//  full tryAppend publishes what fits and append waits for the consumer.
+//
+//  IdleWaiter is for the consumer that runs out of entries: it spins for a moment, then sleeps
+//  until the producer says it published something.
+#ifndef SPSC_CIRCULAR_BUFFER_H
+#define SPSC_CIRCULAR_BUFFER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>   // yield
+#include <vector>
+#include <algorithm>
+
+#define CBUF_CACHE_LINE_SIZE 64
+
+template<typename T>
+class SpscCircularBuffer
+{
+  // indices are free-running entry counts, a slot is index & m_mask.
+  struct alignas( CBUF_CACHE_LINE_SIZE ) ProducerState
+  {
+    std::atomic<size_t> m_tail;   // one past the newest published entry
+    size_t              m_cachedHead;
+  };
+
+  struct alignas( CBUF_CACHE_LINE_SIZE ) ConsumerState
+  {
+    std::atomic<size_t> m_head;   // oldest unconsumed entry
+    size_t              m_cachedTail;
+  };
+
+  ProducerState  m_producer;
+  ConsumerState  m_consumer;
+
+  // read-only after construction, shared by both sides.
+  alignas( CBUF_CACHE_LINE_SIZE ) const size_t m_capacity;
+  const size_t   m_mask;
+  std::vector<T> m_slots;
+
+  static size_t roundUpToPowerOfTwo( const size_t value )
+  {
+    size_t result = 1;
+    while( result < value )
+      result <<= 1;
+    return result;
+  }
+
+  // not copyable.
+  SpscCircularBuffer( const SpscCircularBuffer& );
+  SpscCircularBuffer& operator=( const SpscCircularBuffer& );
+
+public:
+  SpscCircularBuffer( const size_t capacity ) :
+    m_capacity( capacity ),
+    m_mask( roundUpToPowerOfTwo( std::max<size_t>( capacity, 1 ) ) - 1 ),
+    m_slots( m_mask + 1 )
+  {
+    m_producer.m_tail.store( 0, std::memory_order_relaxed );
+    m_producer.m_cachedHead = 0;
+    m_consumer.m_head.store( 0, std::memory_order_relaxed );
+    m_consumer.m_cachedTail = 0;
+  }
+
+  size_t capacity( void ) const { return m_capacity; }
+
+  // approximate when called while the other side is running.
+  size_t size( void ) const
+  {
+    return m_producer.m_tail.load( std::memory_order_acquire ) - m_consumer.m_head.load( std::memory_order_acquire );
+  }
+
+  ///////////////
+  // producer side
+
+  // appends as many of items[0..count) as fit and publishes them all at once. returns how many.
+  size_t tryAppend( const T* items, const size_t count )
+  {
+    const size_t tail = m_producer.m_tail.load( std::memory_order_relaxed );
+    size_t room = m_capacity - ( tail - m_producer.m_cachedHead );
+    if( room < count )
+    {
+      m_producer.m_cachedHead = m_consumer.m_head.load( std::memory_order_acquire );
+      room = m_capacity - ( tail - m_producer.m_cachedHead );
+    }
+
+    const size_t appendCount = std::min( room, count );
+    for( size_t i = 0; i < appendCount; ++i )
+    {
+      m_slots[ ( tail + i ) & m_mask ] = items[ i ];
+    }
+    if( appendCount > 0 )
+    {
+      m_producer.m_tail.store( tail + appendCount, std::memory_order_release );
+    }
+    return appendCount;
+  }
+
+  // appends every entry of list, waiting for the consumer whenever the ring is full.
+  void append( const std::vector<T>& list )
+  {
+    size_t done = 0;
+    while( done < list.size() )
+    {
+      const size_t appended = tryAppend( &list[ done ], list.size() - done );
+      done += appended;
+      if( appended == 0 )
+        std::this_thread::yield();
+    }
+  }
+
+  ///////////////
+  // consumer side
+
+  // moves up to maxCount of the oldest entries onto the end of out and releases their slots
+  // with a single store. returns how many.
+  size_t drain( std::vector<T>& out, const size_t maxCount )
+  {
+    const size_t head = m_consumer.m_head.load( std::memory_order_relaxed );
+    size_t available = m_consumer.m_cachedTail - head;
+    if( available < maxCount )
+    {
+      m_consumer.m_cachedTail = m_producer.m_tail.load( std::memory_order_acquire );
+      available = m_consumer.m_cachedTail - head;
+    }
+
+    const size_t drainCount = std::min( available, maxCount );
+    for( size_t i = 0; i < drainCount; ++i )
+    {
+      out.push_back( m_slots[ ( head + i ) & m_mask ] );
+    }
+    if( drainCount > 0 )
+    {
+      m_consumer.m_head.store( head + drainCount, std::memory_order_release );
+    }
+    return drainCount;
+  }
+
+  bool pop( T& out )
+  {
+    const size_t head = m_consumer.m_head.load( std::memory_order_relaxed );
+    if( m_consumer.m_cachedTail == head )
+    {
+      m_consumer.m_cachedTail = m_producer.m_tail.load( std::memory_order_acquire );
+      if( m_consumer.m_cachedTail == head )
+        return false;
+    }
+    out = m_slots[ head & m_mask ];
+    m_consumer.m_head.store( head + 1, std::memory_order_release );
+    return true;
+  }
+
+  // discards up to count of the oldest entries (the cbuf "R n" command). returns how many.
+  size_t remove( const size_t count )
+  {
+    const size_t head = m_consumer.m_head.load( std::memory_order_relaxed );
+    m_consumer.m_cachedTail = m_producer.m_tail.load( std::memory_order_acquire );
+    const size_t removeCount = std::min( m_consumer.m_cachedTail - head, count );
+    if( removeCount > 0 )
+    {
+      m_consumer.m_head.store( head + removeCount, std::memory_order_release );
+    }
+    return removeCount;
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// IdleWaiter: one thread waits in wait() for a condition on some queues, any thread that
+//  publishes to them calls notify() afterwards. a handoff usually follows close behind the last
+//  one, so wait() polls a little before it goes to sleep on a condition variable. notify() is one
+//  fence and one load unless the waiter is actually asleep.
+
+class IdleWaiter
+{
+  static const unsigned kSpinCount = 64;
+
+  std::mutex              m_mutex;
+  std::condition_variable m_wake;
+  std::atomic<bool>       m_fSleeping;
+
+  // not copyable.
+  IdleWaiter( const IdleWaiter& );
+  IdleWaiter& operator=( const IdleWaiter& );
+
+public:
+  IdleWaiter() : m_mutex(), m_wake() { m_fSleeping.store( false, std::memory_order_relaxed ); }
+
+  // returns once ready() is true. ready should only look at what the notifying side publishes
+  // before it calls notify().
+  template<typename Ready>
+  void wait( Ready ready )
+  {
+    for( unsigned spins = 0; spins < kSpinCount; ++spins )
+    {
+      if( ready() )
+        return;
+      std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for( ;; )
+    {
+      // either the notifier sees m_fSleeping, or we see what it published: the two fences order
+      // each side's store before its load.
+      m_fSleeping.store( true, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      if( ready() )
+        break;
+      m_wake.wait( lock );
+    }
+    m_fSleeping.store( false, std::memory_order_relaxed );
+  }
+
+  void notify( void )
+  {
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if( m_fSleeping.load( std::memory_order_relaxed ) )
+    {
+      // taking the lock means the waiter is either not in its check yet or already in wait().
+      std::lock_guard<std::mutex> lock( m_mutex );
+      m_wake.notify_all();
+    }
+  }
+};
+
+#endif // SPSC_CIRCULAR_BUFFER_H
@@ -0,0 +1,26 @@
+// string-ref.h: non-owning view of a run of bytes (typically one line of the input buffer)
+#ifndef STRING_REF_H
+#define STRING_REF_H
+
+#include <cstddef>  // size_t
+
+class StringRef
+{
+  const char* m_data;
+  size_t      m_length;
+
+public:
+  StringRef() : m_data( 0 ), m_length( 0 )
+  {
+  }
+
+  StringRef( const char* _data, const size_t _length ) : m_data( _data ), m_length( _length )
+  {
+  }
+
+  const char* data( void ) const { return m_data; }
+  size_t length( void ) const { return m_length; }
+  bool empty( void ) const { return m_length == 0; }
+};
+
+#endif // STRING_REF_H
@@ -0,0 +1,336 @@
+// complete-index.cpp: building, loading and querying the completion index (see complete-index.h)
+#include "complete-index.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>  // memcmp, memcpy
+
+static const char kMagic[ 8 ] = { 'F', 'T', 'I', 'D', 'X', '0', '0', '2' };
+
+struct CompletionHeader
+{
+  char     m_magic[ 8 ];
+  uint32_t m_topK;
+  uint32_t m_termCount;
+  uint32_t m_nodeCount;
+  uint32_t m_topsCount;
+  uint32_t m_textBytes;
+  uint32_t m_reserved;  // keeps the counts that follow 8-byte aligned
+};
+
+// first bytes take one byte a node, rounded up so the arrays after them stay aligned.
+static size_t firstBytesSize( const size_t nodeCount )
+{
+  return ( nodeCount + 3 ) & ~static_cast<size_t>( 3 );
+}
+
+// better rank first. ids are in term order, so on equal counts the lower id wins.
+struct IdRankCompare
+{
+  const uint64_t* m_pCounts;
+
+  bool operator()( const uint32_t lhs, const uint32_t rhs ) const
+  {
+    return m_pCounts[ lhs ] != m_pCounts[ rhs ] ? m_pCounts[ lhs ] > m_pCounts[ rhs ] : lhs < rhs;
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CompletionIndexBuilder
+
+CompletionIndexBuilder::CompletionIndexBuilder() :
+  m_text(),
+  m_offsets( 1, 0 ),
+  m_counts()
+{
+}
+
+void CompletionIndexBuilder::add( const char* term, const size_t length, const uint64_t count )
+{
+  m_text.append( term, length );
+  m_offsets.push_back( m_text.length() );
+  m_counts.push_back( count );
+}
+
+bool CompletionIndexBuilder::write( const char* path, const unsigned topK ) const
+{
+  const uint32_t termCount = m_counts.size();
+  const char* text = m_text.data();
+  const uint32_t* offsets = &m_offsets[ 0 ];
+
+  // bytes a and b have in common from depth on (a <= b in term order).
+  struct Common
+  {
+    const char*     m_text;
+    const uint32_t* m_offsets;
+
+    uint32_t operator()( const uint32_t a, const uint32_t b, uint32_t depth ) const
+    {
+      const uint32_t most = std::min( m_offsets[ a + 1 ] - m_offsets[ a ], m_offsets[ b + 1 ] - m_offsets[ b ] );
+      while( depth < most && m_text[ m_offsets[ a ] + depth ] == m_text[ m_offsets[ b ] + depth ] )
+        ++depth;
+      return depth;
+    }
+  } common = { text, offsets };
+
+  // breadth first, so each node's children are appended side by side when it's expanded.
+  std::vector<CompletionNode> nodes;
+  std::vector<unsigned char>  firstBytes;
+  const CompletionNode root = { 0, termCount, termCount > 0 ? common( 0, termCount - 1, 0 ) : 0, 0, 0, 0, 0 };
+  nodes.push_back( root );
+  firstBytes.push_back( 0 );
+  for( size_t i = 0; i < nodes.size(); ++i )
+  {
+    const uint32_t depth = nodes[ i ].m_depth;
+    const uint32_t hi = nodes[ i ].m_hi;
+    uint32_t lo = nodes[ i ].m_lo;
+    // the term that is the whole prefix (there's at most one, and it sorts first) ends here.
+    if( lo < hi && offsets[ lo + 1 ] - offsets[ lo ] == depth )
+      ++lo;
+
+    nodes[ i ].m_firstChild = nodes.size();
+    while( lo < hi )
+    {
+      // the range shares the prefix, so it's sorted by the byte at depth: binary search for where
+      // this byte's group ends.
+      const unsigned char byte = text[ offsets[ lo ] + depth ];
+      uint32_t groupEnd = lo + 1;
+      uint32_t last = hi;
+      while( groupEnd < last )
+      {
+        const uint32_t mid = groupEnd + ( last - groupEnd ) / 2;
+        if( static_cast<unsigned char>( text[ offsets[ mid ] + depth ] ) == byte )
+          groupEnd = mid + 1;
+        else
+          last = mid;
+      }
+
+      const CompletionNode child = { lo, groupEnd, common( lo, groupEnd - 1, depth + 1 ), 0, 0, 0, 0 };
+      nodes.push_back( child );
+      firstBytes.push_back( byte );
+      lo = groupEnd;
+    }
+    nodes[ i ].m_childCount = nodes.size() - nodes[ i ].m_firstChild;
+  }
+
+  // the best K of every node too big to rank at query time.
+  const IdRankCompare rank = { &m_counts[ 0 ] };
+  std::vector<uint32_t> tops;
+  std::vector<uint32_t> ids;
+  for( std::vector<CompletionNode>::iterator it = nodes.begin(); it != nodes.end(); ++it )
+  {
+    if( it->m_hi - it->m_lo <= topK )
+      continue;
+    ids.resize( it->m_hi - it->m_lo );
+    for( uint32_t id = it->m_lo; id < it->m_hi; ++id )
+      ids[ id - it->m_lo ] = id;
+    std::partial_sort( ids.begin(), ids.begin() + topK, ids.end(), rank );
+    it->m_top = tops.size();
+    it->m_topCount = topK;
+    tops.insert( tops.end(), ids.begin(), ids.begin() + topK );
+  }
+
+  CompletionHeader header;
+  memcpy( header.m_magic, kMagic, sizeof( kMagic ) );
+  header.m_topK = topK;
+  header.m_termCount = termCount;
+  header.m_nodeCount = nodes.size();
+  header.m_topsCount = tops.size();
+  header.m_textBytes = m_text.length();
+  header.m_reserved = 0;
+  firstBytes.resize( firstBytesSize( nodes.size() ), 0 );
+
+  std::ofstream out( path, std::ios::binary );
+  out.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+  if( termCount > 0 )
+    out.write( reinterpret_cast<const char*>( &m_counts[ 0 ] ), termCount * sizeof( uint64_t ) );
+  out.write( reinterpret_cast<const char*>( offsets ), m_offsets.size() * sizeof( uint32_t ) );
+  out.write( reinterpret_cast<const char*>( &nodes[ 0 ] ), nodes.size() * sizeof( CompletionNode ) );
+  out.write( reinterpret_cast<const char*>( &firstBytes[ 0 ] ), firstBytes.size() );
+  if( !tops.empty() )
+    out.write( reinterpret_cast<const char*>( &tops[ 0 ] ), tops.size() * sizeof( uint32_t ) );
+  out.write( m_text.data(), m_text.length() );
+  out.close();
+  if( !out )
+  {
+    std::cerr << "error: can't write index " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CompletionIndex
+
+CompletionIndex::CompletionIndex() :
+  m_pFile( 0 ),
+  m_topK( 0 ),
+  m_nodeCount( 0 ),
+  m_pOffsets( 0 ),
+  m_pCounts( 0 ),
+  m_pNodes( 0 ),
+  m_pFirstBytes( 0 ),
+  m_pTops( 0 ),
+  m_pText( 0 )
+{
+}
+
+CompletionIndex::~CompletionIndex()
+{
+  delete m_pFile;
+}
+
+CompletionIndex* CompletionIndex::open( const char* path )
+{
+  InputBuffer* pFile = InputBuffer::open( path );
+  if( !pFile )
+  {
+    std::cerr << "error: can't open index " << path << std::endl;
+    return 0;
+  }
+
+  const size_t fileBytes = pFile->end() - pFile->begin();
+  CompletionHeader header;
+  bool fOk = fileBytes >= sizeof( header );
+  if( fOk )
+  {
+    memcpy( &header, pFile->begin(), sizeof( header ) );
+    fOk = memcmp( header.m_magic, kMagic, sizeof( kMagic ) ) == 0 && header.m_nodeCount > 0 &&
+          fileBytes == sizeof( header ) +
+                       static_cast<size_t>( header.m_termCount ) * sizeof( uint64_t ) +
+                       ( static_cast<size_t>( header.m_termCount ) + 1 ) * sizeof( uint32_t ) +
+                       header.m_nodeCount * sizeof( CompletionNode ) +
+                       firstBytesSize( header.m_nodeCount ) +
+                       header.m_topsCount * sizeof( uint32_t ) +
+                       header.m_textBytes;
+  }
+  if( !fOk )
+  {
+    std::cerr << "error: " << path << " isn't an index" << std::endl;
+    delete pFile;
+    return 0;
+  }
+
+  // the file is mapped (or read into a vector), so it's aligned well enough for every array.
+  CompletionIndex* pIndex = new CompletionIndex();
+  pIndex->m_pFile = pFile;
+  pIndex->m_topK = header.m_topK;
+  pIndex->m_nodeCount = header.m_nodeCount;
+  const char* p = pFile->begin() + sizeof( header );
+  pIndex->m_pCounts = reinterpret_cast<const uint64_t*>( p );
+  p += static_cast<size_t>( header.m_termCount ) * sizeof( uint64_t );
+  pIndex->m_pOffsets = reinterpret_cast<const uint32_t*>( p );
+  p += ( static_cast<size_t>( header.m_termCount ) + 1 ) * sizeof( uint32_t );
+  pIndex->m_pNodes = reinterpret_cast<const CompletionNode*>( p );
+  p += header.m_nodeCount * sizeof( CompletionNode );
+  pIndex->m_pFirstBytes = reinterpret_cast<const unsigned char*>( p );
+  p += firstBytesSize( header.m_nodeCount );
+  pIndex->m_pTops = reinterpret_cast<const uint32_t*>( p );
+  p += header.m_topsCount * sizeof( uint32_t );
+  pIndex->m_pText = p;
+
+  if( !pIndex->isValid( header.m_termCount, header.m_topsCount, header.m_textBytes ) )
+  {
+    std::cerr << "error: " << path << " is corrupt" << std::endl;
+    delete pIndex;
+    return 0;
+  }
+  return pIndex;
+}
+
+bool CompletionIndex::isValid( const uint32_t termCount, const uint32_t topsCount, const uint32_t textBytes ) const
+{
+  if( m_pOffsets[ 0 ] != 0 || m_pOffsets[ termCount ] != textBytes )
+    return false;
+  for( uint32_t id = 0; id < termCount; ++id )
+  {
+    if( m_pOffsets[ id + 1 ] < m_pOffsets[ id ] )
+      return false;
+  }
+
+  for( uint32_t i = 0; i < m_nodeCount; ++i )
+  {
+    const CompletionNode& node = m_pNodes[ i ];
+    if( node.m_lo > node.m_hi || node.m_hi > termCount )
+      return false;
+    // the node's prefix is read out of its first term.
+    if( node.m_lo < node.m_hi && node.m_depth > m_pOffsets[ node.m_lo + 1 ] - m_pOffsets[ node.m_lo ] )
+      return false;
+    // children come after their parent (breadth first), so a query always moves forward.
+    if( node.m_childCount > 0 && ( node.m_firstChild <= i || static_cast<uint64_t>( node.m_firstChild ) + node.m_childCount > m_nodeCount ) )
+      return false;
+    if( node.m_topCount == 0 ? node.m_hi - node.m_lo > m_topK
+                             : node.m_topCount > m_topK || static_cast<uint64_t>( node.m_top ) + node.m_topCount > topsCount )
+      return false;
+  }
+
+  for( uint32_t i = 0; i < topsCount; ++i )
+  {
+    if( m_pTops[ i ] >= termCount )
+      return false;
+  }
+  return true;
+}
+
+void CompletionIndex::complete( const char* prefix, const size_t length, const unsigned k, /*out*/ std::vector<TermRef>& results ) const
+{
+  results.clear();
+  const CompletionNode* pNode = m_pNodes;
+  size_t matched = 0;
+  for( ;; )
+  {
+    if( pNode->m_lo == pNode->m_hi )
+      return;
+    // the node's terms all share its prefix, check the part of it the query hasn't matched yet.
+    const size_t upTo = std::min<size_t>( pNode->m_depth, length );
+    if( upTo > matched && memcmp( m_pText + m_pOffsets[ pNode->m_lo ] + matched, prefix + matched, upTo - matched ) != 0 )
+      return;
+    matched = upTo;
+    if( matched == length )
+      break;
+
+    const unsigned char* first = m_pFirstBytes + pNode->m_firstChild;
+    const unsigned char* last = first + pNode->m_childCount;
+    const unsigned char* child = std::lower_bound( first, last, static_cast<unsigned char>( prefix[ matched ] ) );
+    if( child == last || *child != static_cast<unsigned char>( prefix[ matched ] ) )
+      return;
+    pNode = m_pNodes + ( child - m_pFirstBytes );
+  }
+
+  const size_t want = std::min( k, m_topK );
+  if( pNode->m_topCount > 0 )
+  {
+    const uint32_t* pTop = m_pTops + pNode->m_top;
+    for( size_t i = 0; i < std::min<size_t>( want, pNode->m_topCount ); ++i )
+      results.push_back( termRef( pTop[ i ] ) );
+    return;
+  }
+
+  // at most K terms, rank them now.
+  for( uint32_t id = pNode->m_lo; id < pNode->m_hi; ++id )
+    results.push_back( termRef( id ) );
+  std::sort( results.begin(), results.end(), TermRankCompare() );
+  if( results.size() > want )
+    results.resize( want );
+}
+
+void runCompletions( const CompletionIndex& index, std::istream& input, const unsigned k )
+{
+  LineStream lines( input );
+  std::vector<TermRef> results;
+  const char* begin;
+  const char* end;
+  while( lines.getLine( begin, end ) )
+  {
+    index.complete( begin, end - begin, k, results );
+    for( std::vector<TermRef>::const_iterator it = results.begin(); it != results.end(); ++it )
+    {
+      std::cout.write( it->m_term, it->m_length ) << '\n';
+    }
+    std::cout << '\n';
+  }
+  std::cout.flush();
+}
@@ -0,0 +1,105 @@
+// complete-index.h: "top k terms starting with P" over final term counts, for autocomplete.
+//  "frequent-terms -index <path> [-indexk <K>]" builds the index from the default mode's counts
+//  (or a -merge's), and "frequent-terms -complete <path> <k>" loads it and answers prefix queries,
+//  one per input line: the best min( k, K ) completions, a line each, then an empty line.
+//
+//  the index is a path-compressed trie over the sorted terms. a node stands for a prefix and
+//  covers the range of sorted terms that start with it; its children split that range by the
+//  next byte. nodes are laid out breadth first, so a node's children sit side by side and the
+//  next byte of a query is a binary search over their first bytes. every node covering more than
+//  K terms has its best K precomputed, best first; a smaller node just ranks its (at most K)
+//  terms at query time. so a query costs O( |P| ) to find its node plus O( k ) (O( K log K ) at
+//  worst) to answer. the precomputed lists take K entries per node over K terms: for ordinary
+//  vocabularies that's a small multiple of the term count, but it's O( terms * K ) at worst, eg
+//  for a chain of prefixes (a, aa, aaa, ...) where every node covers nearly all the terms.
+//
+//  the file is the flat arrays themselves, so a query process maps it and reads it in place. the
+//  only work at startup is one pass checking that every offset, range and id stays in bounds:
+//      header: "FTIDX002", then K, term count, node count, list entries, text bytes (uint32 each,
+//          padded to 32 bytes)
+//      counts (uint64, term count), term offsets (term count + 1), nodes, node first bytes
+//      (padded to 4), list entries (term ids), term text
+//  all in native byte order.
+#ifndef COMPLETE_INDEX_H
+#define COMPLETE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "input-buffer.h"
+#include "top-k-selector.h"  // TermRef
+
+struct CompletionNode
+{
+  uint32_t m_lo;          // the range of term ids under the node
+  uint32_t m_hi;
+  uint32_t m_depth;       // prefix length
+  uint32_t m_firstChild;
+  uint32_t m_childCount;
+  uint32_t m_top;         // start of the node's list entries, if it has any
+  uint32_t m_topCount;    // 0 == no list, rank the range instead
+};
+
+///////////////
+
+class CompletionIndexBuilder
+{
+  std::string           m_text;
+  std::vector<uint32_t> m_offsets;  // term id -> start in m_text, plus the end
+  std::vector<uint64_t> m_counts;
+
+public:
+  CompletionIndexBuilder();
+
+  // terms must come in increasing order (TermOrderCompare), each once.
+  void add( const char* term, const size_t length, const uint64_t count );
+
+  // false (after saying why) if the file can't be written.
+  bool write( const char* path, const unsigned topK ) const;
+};
+
+///////////////
+
+class CompletionIndex
+{
+  InputBuffer*          m_pFile;
+  uint32_t              m_topK;
+  uint32_t              m_nodeCount;
+  const uint32_t*       m_pOffsets;
+  const uint64_t*       m_pCounts;
+  const CompletionNode* m_pNodes;
+  const unsigned char*  m_pFirstBytes;
+  const uint32_t*       m_pTops;
+  const char*           m_pText;
+
+  CompletionIndex();
+
+  // not copyable, we own the mapping.
+  CompletionIndex( const CompletionIndex& );
+  CompletionIndex& operator=( const CompletionIndex& );
+
+  // false if anything in the file would send a query out of bounds (or round in circles).
+  bool isValid( const uint32_t termCount, const uint32_t topsCount, const uint32_t textBytes ) const;
+
+  TermRef termRef( const uint32_t id ) const
+  {
+    return TermRef( m_pText + m_pOffsets[ id ], m_pOffsets[ id + 1 ] - m_pOffsets[ id ], m_pCounts[ id ] );
+  }
+
+public:
+  ~CompletionIndex();
+
+  // 0 (after saying why) if the file can't be read or isn't an index.
+  static CompletionIndex* open( const char* path );
+
+  unsigned topK( void ) const { return m_topK; }
+
+  // the best min( k, K ) terms starting with the prefix, best first. they point into the index.
+  void complete( const char* prefix, const size_t length, const unsigned k, /*out*/ std::vector<TermRef>& results ) const;
+};
+
+// answers a query per line of the input until it runs out.
+void runCompletions( const CompletionIndex& index, std::istream& input, const unsigned k );
+
+#endif // COMPLETE_INDEX_H
@@ -1,81 +1,74 @@
 // frequent-terms.cpp: implement the "frequent terms" algorithm as spec'd by the evernote interview challenge (see prompt.txt)
 //  ggoodwin 1/6/2013
-#include <map>
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <memory>
-#include <cstdlib>   // atoi
+#include <cstdlib>   // atoi, strtoul
+#include <cctype>    // tolower
 #include <algorithm>
-#include <set>
+#include <vector>
+
+#include "term-counter.h"
+#include "term-table.h"
+#include "top-k-selector.h"
+#include "input-buffer.h"
+#include "term-normalize.h"
+#include "parallel-ingest.h"
+#include "heavy-hitters.h"
+#include "sliding-window.h"
+#include "stream-summary.h"
+#include "spill-counter.h"
+#include "term-snapshot.h"
+#include "text-ingest.h"
+#include "complete-index.h"
+#include "term-runs.h"  // sortTerms
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // TermCountMap and related
 
-// functor used for set sort
-struct PairValueCompareFunctor
+class TermCountMap : public TermCounter
 {
-  bool operator() (const std::pair<std::string, unsigned> lhs, const std::pair<std::string, unsigned> rhs )
-  {
-    if( lhs.second == rhs.second )
-    {
-      return lhs.first.compare( rhs.first );
-    }
-    return lhs.second < rhs.second;
-  }
-};
-
-class TermCountMap
-{
-  std::map<std::string, unsigned> m_map;
+  TermTable m_terms;
   unsigned m_entriesRemaining;
 
 public:
-  TermCountMap() : m_map(), m_entriesRemaining( 0 )
+  TermCountMap() : m_terms(), m_entriesRemaining( 0 )
   {
   }
 
-  void handle( const std::string newValue );
+  void handle( const TermKey& newValue );
   void setEntriesRemaining( const unsigned remaining );
   void showKResults( const unsigned k );
+
+  const TermTable& terms( void ) const { return m_terms; }
 };
 
-void TermCountMap::handle( const std::string newValue )
+void TermCountMap::handle( const TermKey& newValue )
 {
-  unsigned& existingValue = m_map[ newValue ];  // inserts a default value if none exists yet for this key.
-  existingValue++;
+  m_terms.add( newValue, 1 );
 }
 
 void TermCountMap::setEntriesRemaining( const unsigned remaining )
 {
   m_entriesRemaining = remaining;
-}
-
-void dumpOneKeyValue( const std::pair<std::string, unsigned>& keyValuePair )
-{
-  std::cout << "key: " << keyValuePair.first << " value: " << keyValuePair.second << std::endl;
+  // there can't be more distinct terms than terms. past a point, let the table grow as it finds them.
+  m_terms.reserve( std::min( remaining, 1u << 16 ) );
 }
 
 void TermCountMap::showKResults( const unsigned k )
 {
-  // strategy: use an ordered set with custom compare functor to perform value-then-lexographical sort.
-  // drawback: this uses more memory, could resolve this by using pointers or references in set.
-  std::set<std::pair<std::string, unsigned>, PairValueCompareFunctor> sortSet;
-  for( std::map<std::string, unsigned>::const_iterator it = m_map.begin(); it != m_map.end(); ++it )
-  {
-    //std::cout << "adding to sortSet key: " << (*it).first << " value: " << (*it).second << std::endl;
-    sortSet.insert( *it );
-  }
+  // the selector keeps references into the table, so nothing is copied until output.
+  TopKSelector selector( k, m_terms.size() );
+  m_terms.forEach( selector );
 
-  //std::for_each( sortSet.begin(), sortSet.end(), dumpOneKeyValue );
-  //std::cout << "-----------------" << std::endl;
-  
-  std::set<std::pair<std::string, unsigned>, PairValueCompareFunctor>::reverse_iterator prit = sortSet.rend();
-  unsigned displayCount = 0;
-  while( displayCount++ < k )
+  std::vector<TermRef> best;
+  selector.takeResults( best );
+  for( std::vector<TermRef>::const_iterator it = best.begin(); it != best.end(); ++it )
   {
-    ++prit;
-    std::cout << (*prit).first << std::endl;
+    std::cout.write( it->m_term, it->m_length ) << '\n';
   }
+  std::cout.flush();
 }
 
 
@@ -85,7 +78,7 @@ void TermCountMap::showKResults( const unsigned k )
 class Command
 {
 public:
-  virtual void perform( TermCountMap& tcm ) const = 0;
+  virtual void perform( TermCounter& tcm ) const = 0;
 };
 
 ///////////////
@@ -95,25 +88,26 @@ class SizeCommand : public Command
   const unsigned m_size;
 public:
   SizeCommand( const unsigned _size ) : m_size( _size ) {}
-  void perform( TermCountMap& tcm ) const;
+  void perform( TermCounter& tcm ) const;
 };
 
-void SizeCommand::perform( TermCountMap& tcm ) const
+void SizeCommand::perform( TermCounter& tcm ) const
 {
   tcm.setEntriesRemaining( m_size );
 }
 
 ///////////////
 
+// the entry views the parser's current line, so perform it before asking for the next command.
 class NewEntryCommand : public Command
 {
-  const std::string m_entry;
+  const TermKey m_entry;
 public:
-  NewEntryCommand( const std::string entry ) : m_entry( entry ) {}
-  void perform( TermCountMap& tcm ) const;
+  NewEntryCommand( const TermKey& entry ) : m_entry( entry ) {}
+  void perform( TermCounter& tcm ) const;
 };
 
-void NewEntryCommand::perform( TermCountMap& tcm ) const
+void NewEntryCommand::perform( TermCounter& tcm ) const
 {
   tcm.handle( m_entry );
 }
@@ -125,10 +119,10 @@ class ShowNMostCommonCommand : public Command
   const unsigned m_numToShow;
 public:
   ShowNMostCommonCommand( const unsigned numToShow ) : m_numToShow( numToShow ) {}
-  void perform( TermCountMap& tcm ) const;
+  void perform( TermCounter& tcm ) const;
 };
 
-void ShowNMostCommonCommand::perform( TermCountMap& tcm ) const
+void ShowNMostCommonCommand::perform( TermCounter& tcm ) const
 {
   tcm.showKResults( m_numToShow );
 }
@@ -139,10 +133,10 @@ class QuitCommand : public Command
 {
 public:
   QuitCommand() {}
-  void perform( TermCountMap& tcm ) const;
+  void perform( TermCounter& tcm ) const;
 };
 
-void QuitCommand::perform( TermCountMap& tcm ) const
+void QuitCommand::perform( TermCounter& tcm ) const
 {
   // do nothing
 }
@@ -153,10 +147,10 @@ class CommandError : public Command
 {
 public:
   CommandError() {}
-  void perform( TermCountMap& tcm ) const;
+  void perform( TermCounter& tcm ) const;
 };
 
-void CommandError::perform( TermCountMap& tcm ) const
+void CommandError::perform( TermCounter& tcm ) const
 {
   std::cout << "error: unexpected state." << std::endl;
 }
@@ -168,37 +162,43 @@ void CommandError::perform( TermCountMap& tcm ) const
 class InputParser
 {
   bool            m_didReadSize;
-  std::istream&   m_istream;
+  LineStream      m_lines;
 
   unsigned m_wordsRemaining;
 
 public:
   InputParser( std::istream& _istream ) :
-    m_istream( _istream ),
-    m_didReadSize( false )
+    m_didReadSize( false ),
+    m_lines( _istream ),
+    m_wordsRemaining( 0 )
   { }
 
   std::auto_ptr<const Command> getNextCommand( /*out*/ bool& fDone );
 };
 
-const std::string stringTrim( std::string input )
-{
-  input.erase( input.begin(), std::find_if( input.begin(), input.end(), std::not1( std::ptr_fun<int, int>( std::isspace ) ) ) );
-  input.erase( std::find_if( input.rbegin(), input.rend(), std::not1( std::ptr_fun<int, int>( std::isspace ))).base(), input.end() );
-  return input;
-}  
-
 std::auto_ptr<const Command> InputParser::getNextCommand( /*out*/ bool& fDone )
 {
   fDone = false;
 
-  std::string thisLine;
-  if( !std::getline( m_istream, thisLine ) )
+  const char* lineBegin;
+  const char* lineEnd;
+  if( !m_lines.getLine( lineBegin, lineEnd ) )
   {
     fDone = true;
     return std::auto_ptr<const Command>( new QuitCommand() );
   }
 
+  if( m_wordsRemaining > 0 )
+  {
+    // the hot path: no copy, the term is trimmed and keyed in place.
+    m_wordsRemaining--;
+    TermKey key;
+    normalizeTerm( lineBegin, lineEnd, lineEnd + LineStream::kReadPadding, key );
+    return std::auto_ptr<const Command>( new NewEntryCommand( key ) );
+  }
+
+  // the rest are a line or so each, a copy is fine (and gives atoi its terminator).
+  const std::string thisLine( lineBegin, lineEnd );
   if( !m_didReadSize )
   {
     m_wordsRemaining = atoi( thisLine.c_str() );
@@ -206,10 +206,11 @@ std::auto_ptr<const Command> InputParser::getNextCommand( /*out*/ bool& fDone )
     return std::auto_ptr<const Command>( new SizeCommand( m_wordsRemaining ) );
   }
 
-  if( m_wordsRemaining > 0 )
+  // "A <M>": M more terms follow, so queries can be interleaved with the terms.
+  if( !thisLine.empty() && tolower( thisLine[ 0 ] ) == 'a' )
   {
-    m_wordsRemaining--;
-    return std::auto_ptr<const Command>( new NewEntryCommand( stringTrim( thisLine ) ) );
+    m_wordsRemaining = atoi( thisLine.c_str() + 1 );
+    return std::auto_ptr<const Command>( new SizeCommand( m_wordsRemaining ) );
   }
 
   const unsigned displayN = atoi( thisLine.c_str() );
@@ -227,17 +228,221 @@ std::auto_ptr<const Command> InputParser::getNextCommand( /*out*/ bool& fDone )
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // main
 
+static void usage( void )
+{
+  std::cerr << "usage: frequent-terms [-threads <n> | -approx <counters> [-sketch <width>] | -window <W> | -summary | -spill <megabytes>] [-text <k> [-fold] [-strip]] [-kernel avx2|sse2|scalar] [-snapshot <outFile>] [-index <outFile> [-indexk <K>]] [inputFile]" << std::endl;
+  std::cerr << "       frequent-terms -merge <k> [-snapshot <outFile>] [-index <outFile> [-indexk <K>]] <snapshot>..." << std::endl;
+  std::cerr << "       frequent-terms -complete <indexFile> <k> [queryFile]" << std::endl;
+}
+
 int main( int argc, char **argv )
 {
-  InputParser ip( std::cin );
-  TermCountMap tcm;
+  // LineStream takes what cin's buffer has in one go, which it can only do unsynced.
+  std::ios::sync_with_stdio( false );
+
+  std::vector<const char*> paths;
+  bool fParallel = false;
+  unsigned threadCount = 0;  // 0 == one per hardware thread
+  size_t approxCounters = 0;  // 0 == exact counts
+  size_t sketchWidth = 0;
+  bool fWindow = false;
+  unsigned windowSize = 0;
+  bool fSummary = false;
+  size_t spillBudget = 0;  // 0 == no spilling
+  const char* snapshotPath = 0;
+  bool fMerge = false;
+  unsigned mergeK = 0;
+  bool fText = false;
+  unsigned textK = 0;
+  bool fFold = false;
+  bool fStrip = false;
+  const char* indexPath = 0;
+  unsigned indexK = 10;
+  const char* completePath = 0;
+  unsigned completeK = 0;
+  for( int i = 1; i < argc; ++i )
+  {
+    const std::string arg( argv[ i ] );
+    if( arg == "-threads" && i + 1 < argc )
+    {
+      fParallel = true;
+      threadCount = atoi( argv[ ++i ] );
+    }
+    else if( arg == "-approx" && i + 1 < argc )
+    {
+      approxCounters = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-sketch" && i + 1 < argc )
+    {
+      sketchWidth = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-window" && i + 1 < argc )
+    {
+      fWindow = true;
+      windowSize = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-summary" )
+    {
+      fSummary = true;
+    }
+    else if( arg == "-spill" && i + 1 < argc )
+    {
+      spillBudget = strtoul( argv[ ++i ], 0, 10 ) << 20;
+      if( spillBudget < SpillingTermCounter::kMinBudgetBytes )
+      {
+        std::cerr << "error: -spill needs at least " << ( SpillingTermCounter::kMinBudgetBytes >> 20 ) << " megabytes" << std::endl;
+        return 1;
+      }
+    }
+    else if( arg == "-snapshot" && i + 1 < argc )
+    {
+      snapshotPath = argv[ ++i ];
+    }
+    else if( arg == "-index" && i + 1 < argc )
+    {
+      indexPath = argv[ ++i ];
+    }
+    else if( arg == "-indexk" && i + 1 < argc )
+    {
+      indexK = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-complete" && i + 2 < argc )
+    {
+      completePath = argv[ ++i ];
+      completeK = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-merge" && i + 1 < argc )
+    {
+      fMerge = true;
+      mergeK = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-text" && i + 1 < argc )
+    {
+      fText = true;
+      textK = strtoul( argv[ ++i ], 0, 10 );
+    }
+    else if( arg == "-fold" )
+    {
+      fFold = true;
+    }
+    else if( arg == "-strip" )
+    {
+      fStrip = true;
+    }
+    else if( arg == "-kernel" && i + 1 < argc )
+    {
+      if( !selectNormalizeKernel( argv[ ++i ] ) )
+      {
+        std::cerr << "error: kernel " << argv[ i ] << " isn't available here" << std::endl;
+        return 1;
+      }
+    }
+    else if( arg[ 0 ] == '-' )
+    {
+      usage();
+      return 1;
+    }
+    else
+    {
+      paths.push_back( argv[ i ] );
+    }
+  }
 
-  bool fDone( false );
-  while( !fDone )
+  const unsigned modeCount = fParallel + ( approxCounters > 0 ) + fWindow + fSummary + ( spillBudget > 0 ) + fMerge + ( completePath != 0 );
+  // snapshots and indexes are of the exact counts of the default mode (or of a merge).
+  // -text changes the input, not the counting, so it goes with any mode that reads lines as they come.
+  if( ( sketchWidth > 0 && approxCounters == 0 ) || modeCount > 1 || ( ( snapshotPath || indexPath ) && modeCount > fMerge ) || indexK == 0 ||
+      ( fMerge ? paths.empty() : paths.size() > 1 ) || ( ( fFold || fStrip ) && !fText ) || ( fText && ( fParallel || fMerge || completePath ) ) )
   {
-    std::auto_ptr<const Command> pCmd = ip.getNextCommand( fDone );
-    pCmd->perform( tcm );
+    usage();
+    return 1;
   }
 
+  std::auto_ptr<CompletionIndexBuilder> pIndex( indexPath ? new CompletionIndexBuilder() : 0 );
+  if( fMerge )
+  {
+    if( !mergeSnapshots( paths, mergeK, snapshotPath, pIndex.get() ) )
+      return 1;
+    return pIndex.get() && !pIndex->write( indexPath, indexK ) ? 1 : 0;
+  }
+
+  const char* inputPath = paths.empty() ? 0 : paths[ 0 ];
+
+  if( fParallel )
+  {
+    // the parallel mode splits the raw input between threads, so it wants it all in memory (or mapped).
+    std::auto_ptr<InputBuffer> pInput( InputBuffer::open( inputPath ) );
+    if( !pInput.get() )
+    {
+      std::cerr << "error: can't open input " << inputPath << std::endl;
+      return 1;
+    }
+    runParallel( pInput->begin(), pInput->end(), threadCount );
+    return 0;
+  }
+
+  std::ifstream inputFile;
+  if( inputPath )
+  {
+    inputFile.open( inputPath );
+    if( !inputFile )
+    {
+      std::cerr << "error: can't open input " << inputPath << std::endl;
+      return 1;
+    }
+  }
+  std::istream& input = inputPath ? static_cast<std::istream&>( inputFile ) : std::cin;
+
+  if( completePath )
+  {
+    std::auto_ptr<CompletionIndex> pCompletions( CompletionIndex::open( completePath ) );
+    if( !pCompletions.get() )
+      return 1;
+    runCompletions( *pCompletions, input, completeK );
+    return 0;
+  }
+
+  std::auto_ptr<TermCounter> pCounter;
+  if( approxCounters > 0 )
+    pCounter.reset( new SpaceSavingCounter( approxCounters, sketchWidth ) );
+  else if( fWindow )
+    pCounter.reset( new WindowedTermCounter( windowSize ) );
+  else if( fSummary )
+    pCounter.reset( new StreamSummaryCounter() );
+  else if( spillBudget > 0 )
+    pCounter.reset( new SpillingTermCounter( spillBudget ) );
+  else
+    pCounter.reset( new TermCountMap() );
+
+  if( fText )
+  {
+    TextTokenizer tokenizer( fFold, fStrip );
+    countText( input, tokenizer, *pCounter );
+    pCounter->showKResults( textK );
+  }
+  else
+  {
+    InputParser ip( input );
+    bool fDone( false );
+    while( !fDone )
+    {
+      std::auto_ptr<const Command> pCmd = ip.getNextCommand( fDone );
+      pCmd->perform( *pCounter );
+    }
+  }
+
+  if( snapshotPath && !writeSnapshot( static_cast<const TermCountMap&>( *pCounter ).terms(), snapshotPath ) )
+    return 1;
+  if( pIndex.get() )
+  {
+    std::vector<TermRef> sorted;
+    sortTerms( static_cast<const TermCountMap&>( *pCounter ).terms(), sorted );
+    for( std::vector<TermRef>::const_iterator it = sorted.begin(); it != sorted.end(); ++it )
+    {
+      pIndex->add( it->m_term, it->m_length, it->m_count );
+    }
+    if( !pIndex->write( indexPath, indexK ) )
+      return 1;
+  }
   return 0;
 }
@@ -0,0 +1,235 @@
+// heavy-hitters.cpp: Space-Saving summary and Count-Min sketch (see heavy-hitters.h)
+#include "heavy-hitters.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>  // memcmp, memcpy
+
+#include "top-k-selector.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CountMinSketch
+
+static size_t roundUpToPowerOfTwo( const size_t value )
+{
+  size_t result = 1;
+  while( result < value )
+    result *= 2;
+  return result;
+}
+
+CountMinSketch::CountMinSketch( const size_t width ) :
+  m_mask( roundUpToPowerOfTwo( width ) - 1 ),
+  m_cells( kDepth * ( m_mask + 1 ) )
+{
+}
+
+// one cell per row, by double hashing off the term hash.
+void CountMinSketch::cellsFor( const uint32_t hash, /*out*/ size_t* cells ) const
+{
+  const uint64_t mixed = hash * 0x9E3779B97F4A7C15ull;
+  const uint32_t h1 = static_cast<uint32_t>( mixed >> 32 );
+  const uint32_t h2 = static_cast<uint32_t>( mixed ) | 1;
+  for( unsigned row = 0; row < kDepth; ++row )
+  {
+    cells[ row ] = row * ( m_mask + 1 ) + ( ( h1 + row * h2 ) & m_mask );
+  }
+}
+
+void CountMinSketch::add( const uint32_t hash )
+{
+  // conservative update: only the cells at the current minimum go up, the rest already overcount.
+  size_t cells[ kDepth ];
+  cellsFor( hash, cells );
+  uint32_t least = m_cells[ cells[ 0 ] ];
+  for( unsigned row = 1; row < kDepth; ++row )
+    least = std::min( least, m_cells[ cells[ row ] ] );
+  for( unsigned row = 0; row < kDepth; ++row )
+  {
+    if( m_cells[ cells[ row ] ] == least )
+      ++m_cells[ cells[ row ] ];
+  }
+}
+
+uint32_t CountMinSketch::estimate( const uint32_t hash ) const
+{
+  size_t cells[ kDepth ];
+  cellsFor( hash, cells );
+  uint32_t least = m_cells[ cells[ 0 ] ];
+  for( unsigned row = 1; row < kDepth; ++row )
+    least = std::min( least, m_cells[ cells[ row ] ] );
+  return least;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SpaceSavingCounter
+
+const int32_t SpaceSavingCounter::kNoCounter;
+
+SpaceSavingCounter::SpaceSavingCounter( const size_t _capacity, const size_t sketchWidth ) :
+  m_capacity( std::max<size_t>( _capacity, 1 ) ),
+  m_counters(),
+  m_heap(),
+  m_index(),
+  m_indexMask( 0 ),
+  m_pSketch( sketchWidth > 0 ? new CountMinSketch( sketchWidth ) : 0 )
+{
+  // all the memory this will ever use, up front.
+  m_counters.reserve( m_capacity );
+  m_heap.reserve( m_capacity );
+  const size_t indexSize = roundUpToPowerOfTwo( m_capacity * 2 );
+  m_index.assign( indexSize, kNoCounter );
+  m_indexMask = indexSize - 1;
+}
+
+// linear probing: the slot holding the key's counter, or the empty slot where it would go.
+size_t SpaceSavingCounter::findSlot( const char* paddedKey, const uint32_t hash, const size_t length ) const
+{
+  size_t slot = hash & m_indexMask;
+  for( ;; )
+  {
+    const int32_t i = m_index[ slot ];
+    // the length too: padding can't tell "a" from "a\0".
+    if( i == kNoCounter || ( m_counters[ i ].m_hash == hash && m_counters[ i ].m_length == length && memcmp( m_counters[ i ].m_key, paddedKey, TermKey::kInlineBytes ) == 0 ) )
+      return slot;
+    slot = ( slot + 1 ) & m_indexMask;
+  }
+}
+
+// backward-shift delete, so lookups never need tombstones.
+void SpaceSavingCounter::eraseSlot( size_t slot )
+{
+  size_t next = slot;
+  for( ;; )
+  {
+    next = ( next + 1 ) & m_indexMask;
+    const int32_t i = m_index[ next ];
+    if( i == kNoCounter )
+      break;
+    const size_t home = m_counters[ i ].m_hash & m_indexMask;
+    // the entry at next may move back to slot only if that doesn't put it before its home.
+    if( ( ( next - home ) & m_indexMask ) >= ( ( next - slot ) & m_indexMask ) )
+    {
+      m_index[ slot ] = i;
+      slot = next;
+    }
+  }
+  m_index[ slot ] = kNoCounter;
+}
+
+void SpaceSavingCounter::swapHeap( const uint32_t a, const uint32_t b )
+{
+  std::swap( m_heap[ a ], m_heap[ b ] );
+  m_counters[ m_heap[ a ] ].m_heapPos = a;
+  m_counters[ m_heap[ b ] ].m_heapPos = b;
+}
+
+void SpaceSavingCounter::siftUp( uint32_t pos )
+{
+  while( pos > 0 )
+  {
+    const uint32_t parent = ( pos - 1 ) / 2;
+    if( m_counters[ m_heap[ parent ] ].m_count <= m_counters[ m_heap[ pos ] ].m_count )
+      break;
+    swapHeap( pos, parent );
+    pos = parent;
+  }
+}
+
+void SpaceSavingCounter::siftDown( uint32_t pos )
+{
+  const uint32_t size = m_heap.size();
+  for( ;; )
+  {
+    const uint32_t left = pos * 2 + 1;
+    if( left >= size )
+      break;
+    uint32_t least = left;
+    if( left + 1 < size && m_counters[ m_heap[ left + 1 ] ].m_count < m_counters[ m_heap[ left ] ].m_count )
+      least = left + 1;
+    if( m_counters[ m_heap[ pos ] ].m_count <= m_counters[ m_heap[ least ] ].m_count )
+      break;
+    swapHeap( pos, least );
+    pos = least;
+  }
+}
+
+void SpaceSavingCounter::handle( const TermKey& newValue )
+{
+  const TermKey key = newValue.m_length <= TermKey::kInlineBytes ? newValue : TermKey( newValue.m_term, TermKey::kInlineBytes );
+  if( m_pSketch.get() )
+    m_pSketch->add( key.m_hash );
+
+  const size_t slot = findSlot( key.m_padded, key.m_hash, key.m_length );
+  if( m_index[ slot ] != kNoCounter )
+  {
+    Counter& counter = m_counters[ m_index[ slot ] ];
+    ++counter.m_count;
+    siftDown( counter.m_heapPos );
+    return;
+  }
+
+  if( m_counters.size() < m_capacity )
+  {
+    Counter counter;
+    memcpy( counter.m_key, key.m_padded, TermKey::kInlineBytes );
+    counter.m_hash = key.m_hash;
+    counter.m_length = key.m_length;
+    counter.m_count = 1;
+    counter.m_error = 0;
+    counter.m_heapPos = m_heap.size();
+    m_index[ slot ] = m_counters.size();
+    m_heap.push_back( m_counters.size() );
+    m_counters.push_back( counter );
+    siftUp( counter.m_heapPos );
+    return;
+  }
+
+  // full: the least counted term makes way, and the newcomer takes over its count as error.
+  const uint32_t victim = m_heap[ 0 ];
+  Counter& counter = m_counters[ victim ];
+  eraseSlot( findSlot( counter.m_key, counter.m_hash, counter.m_length ) );
+  memcpy( counter.m_key, key.m_padded, TermKey::kInlineBytes );
+  counter.m_hash = key.m_hash;
+  counter.m_length = key.m_length;
+  counter.m_error = counter.m_count;
+  ++counter.m_count;
+  m_index[ findSlot( key.m_padded, key.m_hash, key.m_length ) ] = victim;
+  siftDown( 0 );
+}
+
+// orders counter indexes the way the exact mode orders terms.
+struct CounterRankCompare
+{
+  const std::vector<SpaceSavingCounter::Counter>& m_counters;
+
+  CounterRankCompare( const std::vector<SpaceSavingCounter::Counter>& _counters ) : m_counters( _counters ) {}
+
+  bool operator()( const uint32_t lhs, const uint32_t rhs ) const
+  {
+    const SpaceSavingCounter::Counter& l = m_counters[ lhs ];
+    const SpaceSavingCounter::Counter& r = m_counters[ rhs ];
+    return TermRankCompare()( TermRef( l.m_key, l.m_length, l.m_count ), TermRef( r.m_key, r.m_length, r.m_count ) );
+  }
+};
+
+void SpaceSavingCounter::showKResults( const unsigned k )
+{
+  // at most m_capacity counters, so just rank them all.
+  std::vector<uint32_t> order( m_counters.size() );
+  for( uint32_t i = 0; i < order.size(); ++i )
+    order[ i ] = i;
+  const size_t showCount = std::min<size_t>( k, order.size() );
+  std::partial_sort( order.begin(), order.begin() + showCount, order.end(), CounterRankCompare( m_counters ) );
+
+  for( size_t i = 0; i < showCount; ++i )
+  {
+    const Counter& counter = m_counters[ order[ i ] ];
+    uint32_t upper = counter.m_count;
+    if( m_pSketch.get() )
+      upper = std::min( upper, m_pSketch->estimate( counter.m_hash ) );
+    std::cout.write( counter.m_key, counter.m_length ) << ' ' << counter.m_count - counter.m_error << ' ' << upper << '\n';
+  }
+  std::cout.flush();
+}
@@ -0,0 +1,89 @@
+// heavy-hitters.h: "frequent-terms -approx <counters>" counts in fixed memory, for streams too
+//  big (or too endless) for an exact table.
+//
+//  SpaceSavingCounter monitors at most <counters> terms. a monitored term counts exactly from the
+//  moment it was taken on; a new term evicts the least counted one and inherits its count as an
+//  overestimate, remembered as the term's error. so for every reported term
+//      count - error <= true count <= count
+//  and any term occurring more than (terms seen) / <counters> times is guaranteed to be monitored.
+//
+//  with "-sketch <width>" a Count-Min sketch (4 rows of <width> cells, conservative update) also
+//  sees every term, and its estimate tightens the upper bound of terms that were taken on late.
+//
+//  each output line is "term lower upper". terms are ranked by count as in the exact mode.
+//  terms longer than the spec's 24 chars are counted by their first 24.
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "term-counter.h"
+#include "term-table.h"  // TermKey
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CountMinSketch
+
+class CountMinSketch
+{
+  const size_t          m_mask;   // width - 1, width is a power of two
+  std::vector<uint32_t> m_cells;  // kDepth rows of width
+
+  void cellsFor( const uint32_t hash, /*out*/ size_t* cells ) const;
+
+public:
+  static const unsigned kDepth = 4;
+
+  // width is rounded up to a power of two.
+  CountMinSketch( const size_t width );
+
+  void add( const uint32_t hash );
+
+  // never less than the true count.
+  uint32_t estimate( const uint32_t hash ) const;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SpaceSavingCounter
+
+class SpaceSavingCounter : public TermCounter
+{
+  friend struct CounterRankCompare;
+
+  struct Counter
+  {
+    char     m_key[ TermKey::kInlineBytes ];  // zero-padded
+    uint32_t m_hash;
+    uint32_t m_length;
+    uint32_t m_count;
+    uint32_t m_error;
+    uint32_t m_heapPos;
+  };
+
+  static const int32_t kNoCounter = -1;
+
+  const size_t                  m_capacity;
+  std::vector<Counter>          m_counters;
+  std::vector<uint32_t>         m_heap;   // counter indexes, least counted on top
+  std::vector<int32_t>          m_index;  // open addressing over m_counters by key
+  size_t                        m_indexMask;
+  std::auto_ptr<CountMinSketch> m_pSketch;
+
+  size_t findSlot( const char* paddedKey, const uint32_t hash, const size_t length ) const;
+  void   eraseSlot( size_t slot );
+  void   siftUp( uint32_t pos );
+  void   siftDown( uint32_t pos );
+  void   swapHeap( const uint32_t a, const uint32_t b );
+
+public:
+  // sketchWidth == 0 means no sketch.
+  SpaceSavingCounter( const size_t _capacity, const size_t sketchWidth );
+
+  void handle( const TermKey& newValue );
+  void setEntriesRemaining( const unsigned remaining ) {}
+  void showKResults( const unsigned k );
+};
+
+#endif // HEAVY_HITTERS_H
@@ -0,0 +1,146 @@
+// input-buffer.cpp: mmap or read-it-all implementation of InputBuffer (see input-buffer.h)
+#include "input-buffer.h"
+
+#include <fstream>
+#include <cstring>     // memchr, memmove
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+
+static void readAll( std::istream& _istream, /*out*/ std::vector<char>& buf )
+{
+  const size_t blockSize = 1 << 16;
+  size_t used = 0;
+  while( _istream )
+  {
+    buf.resize( used + blockSize );
+    _istream.read( &buf[ used ], blockSize );
+    used += _istream.gcount();
+  }
+  buf.resize( used );
+}
+
+/*static*/ InputBuffer* InputBuffer::open( const char* path )
+{
+  InputBuffer* pInput = new InputBuffer();
+  if( path )
+  {
+    const int fd = ::open( path, O_RDONLY );
+    if( fd < 0 )
+    {
+      delete pInput;
+      return 0;
+    }
+    struct stat info;
+    if( fstat( fd, &info ) == 0 && S_ISREG( info.st_mode ) && info.st_size > 0 )
+    {
+      void* pMap = mmap( 0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if( pMap != MAP_FAILED )
+      {
+        // we scan the input front to back, a chunk per thread.
+        madvise( pMap, info.st_size, MADV_SEQUENTIAL );
+        pInput->m_data = static_cast<const char*>( pMap );
+        pInput->m_length = info.st_size;
+        pInput->m_fMapped = true;
+        ::close( fd );
+        return pInput;
+      }
+    }
+    ::close( fd );
+
+    std::ifstream file( path, std::ios::binary );
+    readAll( file, pInput->m_buf );
+  }
+  else
+  {
+    readAll( std::cin, pInput->m_buf );
+  }
+  pInput->m_data = pInput->m_buf.empty() ? 0 : &pInput->m_buf[ 0 ];
+  pInput->m_length = pInput->m_buf.size();
+  return pInput;
+}
+
+InputBuffer::~InputBuffer()
+{
+  if( m_fMapped )
+  {
+    munmap( const_cast<char*>( m_data ), m_length );
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// LineStream
+
+LineStream::LineStream( std::istream& _istream ) :
+  m_pStreamBuf( _istream.rdbuf() ),
+  m_buf( ( 1 << 16 ) + kReadPadding ),
+  m_begin( 0 ),
+  m_used( 0 ),
+  m_fEof( false )
+{
+}
+
+// reads more input after m_used, making room first if needed. takes whatever is available without
+// blocking, and blocks only when nothing is. false if there was nothing left to read.
+bool LineStream::fill( void )
+{
+  if( m_fEof )
+    return false;
+
+  // slide the partial line down to the front, or grow if it already fills the buffer.
+  if( m_begin > 0 )
+  {
+    memmove( &m_buf[ 0 ], &m_buf[ m_begin ], m_used - m_begin );
+    m_used -= m_begin;
+    m_begin = 0;
+  }
+  const size_t capacity = m_buf.size() - kReadPadding;
+  if( m_used == capacity )
+    m_buf.resize( capacity * 2 + kReadPadding );
+  const size_t room = m_buf.size() - kReadPadding - m_used;
+
+  std::streamsize available = m_pStreamBuf->in_avail();
+  if( available <= 0 )
+  {
+    const int c = m_pStreamBuf->sbumpc();
+    if( c == std::char_traits<char>::eof() )
+    {
+      m_fEof = true;
+      return false;
+    }
+    m_buf[ m_used++ ] = static_cast<char>( c );
+    return true;
+  }
+  m_used += m_pStreamBuf->sgetn( &m_buf[ m_used ], std::min<std::streamsize>( available, room ) );
+  return true;
+}
+
+bool LineStream::getLine( /*out*/ const char*& begin, /*out*/ const char*& end )
+{
+  size_t scanned = m_begin;
+  for( ;; )
+  {
+    const char* newline = static_cast<const char*>( memchr( &m_buf[ scanned ], '\n', m_used - scanned ) );
+    if( newline )
+    {
+      begin = &m_buf[ m_begin ];
+      end = newline;
+      m_begin = newline + 1 - &m_buf[ 0 ];
+      return true;
+    }
+    scanned = m_used - m_begin;  // offset from m_begin, which fill() moves to 0
+    if( !fill() )
+      break;
+    scanned += m_begin;
+  }
+
+  // last line, no newline
+  if( m_begin == m_used )
+    return false;
+  begin = &m_buf[ m_begin ];
+  end = &m_buf[ m_used ];
+  m_begin = m_used;
+  return true;
+}
@@ -0,0 +1,59 @@
+// input-buffer.h: getting frequent-terms input into memory without a std::string per line.
+//  InputBuffer holds the whole input as one contiguous, read-only byte range, for the modes that
+//  split up the raw bytes: a named file is memory-mapped, stdin (or a file that can't be mapped)
+//  is read into memory once. LineStream reads a block at a time as lines are asked for, so it
+//  works on an endless feed too.
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+#include <iostream>
+#include <vector>
+#include <cstddef>  // size_t
+
+class InputBuffer
+{
+  const char*       m_data;
+  size_t            m_length;
+  bool              m_fMapped;
+  std::vector<char> m_buf;  // when not mapped
+
+  InputBuffer() : m_data( 0 ), m_length( 0 ), m_fMapped( false ), m_buf() {}
+
+  // not copyable, we may own a mapping.
+  InputBuffer( const InputBuffer& );
+  InputBuffer& operator=( const InputBuffer& );
+
+public:
+  ~InputBuffer();
+
+  const char* begin( void ) const { return m_data; }
+  const char* end( void ) const { return m_data + m_length; }
+
+  // path == 0 means stdin. returns 0 if the input can't be opened.
+  static InputBuffer* open( const char* path );
+};
+
+///////////////
+
+class LineStream
+{
+  std::streambuf*   m_pStreamBuf;
+  std::vector<char> m_buf;    // always kReadPadding bytes longer than the data it can hold
+  size_t            m_begin;  // start of the unread data
+  size_t            m_used;   // end of the data
+  bool              m_fEof;
+
+  bool fill( void );
+
+public:
+  // any line handed out can be read this far past its end (the bytes there are garbage).
+  static const size_t kReadPadding = 32;
+
+  LineStream( std::istream& _istream );
+
+  // the next line, without its newline. the view stays valid until the next call. false at the
+  // end of input, like std::getline.
+  bool getLine( /*out*/ const char*& begin, /*out*/ const char*& end );
+};
+
+#endif // INPUT_BUFFER_H
@@ -0,0 +1,209 @@
+// parallel-ingest.cpp: partitioned multi-threaded term counting (see parallel-ingest.h)
+#include "parallel-ingest.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>  // atoi
+#include <cctype>   // tolower
+#include <cstring>  // memchr
+
+#include "term-normalize.h"
+#include "top-k-selector.h"
+
+// end of the line starting at p: its newline, or end.
+static const char* lineEnd( const char* p, const char* end )
+{
+  const char* newline = static_cast<const char*>( memchr( p, '\n', end - p ) );
+  return newline ? newline : end;
+}
+
+static const char* nextLine( const char* p, const char* end )
+{
+  const char* eol = lineEnd( p, end );
+  return eol == end ? end : eol + 1;
+}
+
+// cuts [begin, end) into count roughly equal chunks that start and end on line boundaries.
+// chunk i is [bounds[i], bounds[i + 1]).
+static void splitAtLines( const char* begin, const char* end, const unsigned count, /*out*/ std::vector<const char*>& bounds )
+{
+  bounds.clear();
+  bounds.push_back( begin );
+  for( unsigned i = 1; i < count; ++i )
+  {
+    const char* p = begin + ( end - begin ) * i / count;
+    p = std::max( p, bounds.back() );
+    // a cut that lands right after a newline is already a line start.
+    if( p != begin && p != end && p[ -1 ] != '\n' )
+      p = nextLine( p, end );
+    bounds.push_back( p );
+  }
+  bounds.push_back( end );
+}
+
+// which partition a term belongs to. uses the high bits of the hash, the tables index by the low ones.
+static unsigned partitionOf( const uint32_t hash, const unsigned partitionCount )
+{
+  return static_cast<unsigned>( ( static_cast<uint64_t>( hash ) * partitionCount ) >> 32 );
+}
+
+// runs work( i ) for i in [0, count) on count threads and waits for all of them.
+template<typename F>
+static void runOnThreads( const unsigned count, F work )
+{
+  std::vector<std::thread> threads;
+  for( unsigned i = 1; i < count; ++i )
+    threads.push_back( std::thread( work, i ) );
+  work( 0 );
+  for( size_t i = 0; i < threads.size(); ++i )
+    threads[ i ].join();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ParallelTermCounts
+
+ParallelTermCounts::ParallelTermCounts( const unsigned _threadCount ) :
+  m_threadCount( _threadCount ),
+  m_partitions( _threadCount )
+{
+}
+
+void ParallelTermCounts::ingest( const char* begin, const char* end )
+{
+  const unsigned threadCount = m_threadCount;
+  std::vector<const char*> bounds;
+  splitAtLines( begin, end, threadCount, bounds );
+
+  // local[ thread ][ partition ]
+  std::vector< std::vector<TermTable> > local( threadCount );
+  runOnThreads( threadCount, [&]( const unsigned t )
+  {
+    std::vector<TermTable>& tables = local[ t ];
+    tables.resize( threadCount );
+    const char* p = bounds[ t ];
+    const char* chunkEnd = bounds[ t + 1 ];
+    while( p != chunkEnd )
+    {
+      const char* eol = lineEnd( p, chunkEnd );
+      // reads past a line never go beyond the terms being ingested.
+      TermKey key;
+      normalizeTerm( p, eol, end, key );
+      tables[ partitionOf( key.m_hash, threadCount ) ].add( key, 1 );
+      p = eol == chunkEnd ? chunkEnd : eol + 1;
+    }
+  } );
+
+  runOnThreads( threadCount, [&]( const unsigned partition )
+  {
+    TermTable& merged = m_partitions[ partition ];
+    for( unsigned t = 0; t < threadCount; ++t )
+    {
+      TermTable& part = local[ t ][ partition ];
+      if( merged.size() == 0 )
+        merged.swap( part );
+      else
+        merged.merge( part );
+      TermTable().swap( part );  // give the memory back as we go
+    }
+  } );
+}
+
+void ParallelTermCounts::showKResults( const unsigned k )
+{
+  std::vector< std::vector<TermRef> > winners( m_threadCount );
+  runOnThreads( m_threadCount, [&]( const unsigned partition )
+  {
+    TopKSelector selector( k, m_partitions[ partition ].size() );
+    m_partitions[ partition ].forEach( selector );
+    selector.takeResults( winners[ partition ] );
+  } );
+
+  size_t candidateCount = 0;
+  for( unsigned i = 0; i < m_threadCount; ++i )
+    candidateCount += winners[ i ].size();
+  TopKSelector selector( k, candidateCount );
+  for( unsigned i = 0; i < m_threadCount; ++i )
+  {
+    for( std::vector<TermRef>::const_iterator it = winners[ i ].begin(); it != winners[ i ].end(); ++it )
+      selector.offer( *it );
+  }
+
+  std::vector<TermRef> best;
+  selector.takeResults( best );
+  for( std::vector<TermRef>::const_iterator it = best.begin(); it != best.end(); ++it )
+  {
+    std::cout.write( it->m_term, it->m_length ) << '\n';
+  }
+  std::cout.flush();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// runParallel
+
+// the end of the first lineCount lines of [begin, end), counting newlines a chunk per thread.
+static const char* skipLines( const char* begin, const char* end, size_t lineCount, const unsigned threadCount )
+{
+  std::vector<const char*> bounds;
+  splitAtLines( begin, end, threadCount, bounds );
+  std::vector<size_t> newlines( threadCount );
+  runOnThreads( threadCount, [&]( const unsigned t )
+  {
+    newlines[ t ] = std::count( bounds[ t ], bounds[ t + 1 ], '\n' );
+  } );
+
+  for( unsigned t = 0; t < threadCount; ++t )
+  {
+    if( lineCount <= newlines[ t ] )
+    {
+      const char* p = bounds[ t ];
+      while( lineCount-- > 0 )
+        p = nextLine( p, end );
+      return p;
+    }
+    lineCount -= newlines[ t ];
+  }
+  return end;
+}
+
+// same line-by-line behavior as InputParser: N, N terms, then any number of k lines and "A <M>"
+// lines (M more terms), stopping quietly at the end of input or with an error at a k that isn't
+// positive.
+void runParallel( const char* begin, const char* end, unsigned threadCount )
+{
+  if( threadCount == 0 )
+    threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+
+  if( begin == end )
+    return;
+  const char* p = nextLine( begin, end );
+  const size_t termCount = atoi( std::string( begin, lineEnd( begin, end ) ).c_str() );
+
+  const char* termsEnd = skipLines( p, end, termCount, threadCount );
+  ParallelTermCounts counts( threadCount );
+  counts.ingest( p, termsEnd );
+
+  for( p = termsEnd; p != end; )
+  {
+    const std::string line( p, lineEnd( p, end ) );
+    p = nextLine( p, end );
+    if( !line.empty() && tolower( line[ 0 ] ) == 'a' )
+    {
+      termsEnd = skipLines( p, end, atoi( line.c_str() + 1 ), threadCount );
+      counts.ingest( p, termsEnd );
+      p = termsEnd;
+      continue;
+    }
+
+    const unsigned k = atoi( line.c_str() );
+    if( k == 0 )
+    {
+      std::cout << "error: unexpected state." << std::endl;
+      return;
+    }
+    counts.showKResults( k );
+  }
+}
@@ -0,0 +1,31 @@
+// parallel-ingest.h: "frequent-terms -threads <n>" counts the terms on n threads.
+//  the term lines are cut into n chunks at line boundaries and each thread counts its chunk into
+//  tables of its own, one per partition of the hash space. then each thread merges one partition
+//  across every thread's tables, so the merge shares nothing either. a top-k query picks the
+//  best k of each partition in parallel and combines the partition winners.
+#ifndef PARALLEL_INGEST_H
+#define PARALLEL_INGEST_H
+
+#include <vector>
+
+#include "term-table.h"
+
+class ParallelTermCounts
+{
+  const unsigned         m_threadCount;
+  std::vector<TermTable> m_partitions;  // disjoint, a term is in the one its hash picks
+
+public:
+  ParallelTermCounts( const unsigned _threadCount );
+
+  // counts every line of [begin, end) as a term. begin must be at a line start.
+  void ingest( const char* begin, const char* end );
+
+  void showKResults( const unsigned k );
+};
+
+// runs a whole frequent-terms input (N, N terms, then the k lines) held in [begin, end).
+// threadCount == 0 means one per hardware thread.
+void runParallel( const char* begin, const char* end, unsigned threadCount );
+
+#endif // PARALLEL_INGEST_H
@@ -0,0 +1,92 @@
+// sliding-window.cpp: top-k over the last W terms (see sliding-window.h)
+#include "sliding-window.h"
+
+#include <iostream>
+
+#include "top-k-selector.h"  // TermRankCompare
+
+bool WindowedTermCounter::RankCompare::operator()( const uint32_t lhs, const uint32_t rhs ) const
+{
+  const Term& l = m_terms[ lhs ];
+  const Term& r = m_terms[ rhs ];
+  return TermRankCompare()( TermRef( l.m_text->data(), l.m_text->length(), l.m_count ),
+                            TermRef( r.m_text->data(), r.m_text->length(), r.m_count ) );
+}
+
+WindowedTermCounter::WindowedTermCounter( const unsigned _windowSize ) :
+  m_windowSize( _windowSize ),
+  m_window( _windowSize ),
+  m_insertPoint( 0 ),
+  m_itemCount( 0 ),
+  m_terms(),
+  m_freeIds(),
+  m_ids(),
+  m_ranking( RankCompare( m_terms ) )
+{
+}
+
+uint32_t WindowedTermCounter::idFor( const std::string& text )
+{
+  IdMap::iterator it = m_ids.find( text );
+  if( it != m_ids.end() )
+    return it->second;
+
+  uint32_t id = m_terms.size();
+  if( !m_freeIds.empty() )
+  {
+    id = m_freeIds.back();
+    m_freeIds.pop_back();
+  }
+  else
+  {
+    m_terms.push_back( Term() );
+  }
+  it = m_ids.insert( IdMap::value_type( text, id ) ).first;
+  m_terms[ id ].m_text = &it->first;
+  m_terms[ id ].m_count = 0;
+  return id;
+}
+
+void WindowedTermCounter::adjust( const uint32_t id, const int delta )
+{
+  Term& term = m_terms[ id ];
+  if( term.m_count > 0 )
+    m_ranking.erase( id );
+  term.m_count += delta;
+  if( term.m_count > 0 )
+  {
+    m_ranking.insert( id );
+    return;
+  }
+  // left the window entirely.
+  m_ids.erase( *term.m_text );
+  term.m_text = 0;
+  m_freeIds.push_back( id );
+}
+
+void WindowedTermCounter::handle( const TermKey& newValue )
+{
+  if( m_windowSize == 0 )
+    return;
+
+  // the oldest term leaves first, it may be the last of its kind and free its id.
+  if( m_itemCount == m_windowSize )
+    adjust( m_window[ m_insertPoint ], -1 );
+  else
+    ++m_itemCount;
+
+  const uint32_t id = idFor( std::string( newValue.m_term, newValue.m_length ) );
+  m_window[ m_insertPoint ] = id;
+  m_insertPoint = m_insertPoint + 1 == m_windowSize ? 0 : m_insertPoint + 1;
+  adjust( id, 1 );
+}
+
+void WindowedTermCounter::showKResults( const unsigned k )
+{
+  unsigned displayCount = 0;
+  for( Ranking::const_iterator it = m_ranking.begin(); it != m_ranking.end() && displayCount < k; ++it, ++displayCount )
+  {
+    std::cout << *m_terms[ *it ].m_text << '\n';
+  }
+  std::cout.flush();
+}
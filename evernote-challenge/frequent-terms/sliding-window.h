@@ -0,0 +1,59 @@
+// sliding-window.h: "frequent-terms -window <W>" ranks only the last W terms seen.
+//  the window is a ring of term ids like the slot ring in circular-buffer/cbuf: each new term
+//  takes the slot of the one leaving, so a term costs one increment and (once the window is full)
+//  one decrement. every live term is kept in a ranking ordered the way the output is, updated
+//  as counts change, so a top-k query just reads the first k off it, no rescan of the window.
+//  terms whose count drops to zero are forgotten, so memory is bounded by W whatever the input.
+#ifndef SLIDING_WINDOW_H
+#define SLIDING_WINDOW_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "term-counter.h"
+
+class WindowedTermCounter : public TermCounter
+{
+  struct Term
+  {
+    const std::string* m_text;  // the key in m_ids, which stays put through rehashes
+    unsigned           m_count;
+  };
+
+  // orders term ids by their current counts, so an id must be out of the set while its count changes.
+  struct RankCompare
+  {
+    const std::vector<Term>& m_terms;
+
+    RankCompare( const std::vector<Term>& _terms ) : m_terms( _terms ) {}
+    bool operator()( const uint32_t lhs, const uint32_t rhs ) const;
+  };
+
+  typedef std::unordered_map<std::string, uint32_t> IdMap;
+  typedef std::set<uint32_t, RankCompare>           Ranking;
+
+  const unsigned        m_windowSize;
+  std::vector<uint32_t> m_window;  // term ids, a ring
+  unsigned              m_insertPoint;
+  unsigned              m_itemCount;
+
+  std::vector<Term>     m_terms;    // by id
+  std::vector<uint32_t> m_freeIds;  // ids of forgotten terms, for reuse
+  IdMap                 m_ids;
+  Ranking               m_ranking;  // every term with a nonzero count, best first
+
+  uint32_t idFor( const std::string& text );
+  void     adjust( const uint32_t id, const int delta );
+
+public:
+  WindowedTermCounter( const unsigned _windowSize );
+
+  void handle( const TermKey& newValue );
+  void setEntriesRemaining( const unsigned remaining ) {}
+  void showKResults( const unsigned k );
+};
+
+#endif // SLIDING_WINDOW_H
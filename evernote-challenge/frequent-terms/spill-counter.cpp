@@ -0,0 +1,305 @@
+// spill-counter.cpp: exact counting with sorted runs on disk (see spill-counter.h)
+#include "spill-counter.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>  // exit
+#ifdef __GLIBC__
+#include <malloc.h>  // malloc_trim
+#endif
+
+#include "term-runs.h"
+
+// room for the process itself (code, libraries, stream buffers) before the counter's own memory.
+static const size_t kProcessBytes = 4 << 20;
+
+static void showTerms( const std::vector<TermRef>& terms )
+{
+  for( std::vector<TermRef>::const_iterator it = terms.begin(); it != terms.end(); ++it )
+  {
+    std::cout.write( it->m_term, it->m_length ) << '\n';
+  }
+  std::cout.flush();
+}
+
+static FILE* openRunOrDie( void )
+{
+  FILE* pFile = openRunFile();
+  if( !pFile )
+  {
+    std::cerr << "error: can't create a spill file" << std::endl;
+    exit( 1 );
+  }
+  return pFile;
+}
+
+static void finishRunOrDie( RunWriter& writer )
+{
+  if( !writer.finish() )
+  {
+    std::cerr << "error: can't write a spill file" << std::endl;
+    exit( 1 );
+  }
+}
+
+// after freeing lots of small blocks (overflow terms, kept terms), so the pages they're scattered
+// over go back to the system before the memory is spent again on something else.
+static void releaseFreedMemory( void )
+{
+#ifdef __GLIBC__
+  malloc_trim( 0 );
+#endif
+}
+
+static void checkRunOrDie( const RunReader& reader )
+{
+  if( reader.bad() )
+  {
+    std::cerr << "error: can't read a spill file" << std::endl;
+    exit( 1 );
+  }
+}
+
+struct IgnoreTerms
+{
+  void operator()( const char*, const size_t, const uint64_t ) {}
+};
+
+// replaces runs with one run of the first maxRecords terms of their merge, handing each term to
+// visit as it's written.
+template<typename Visitor>
+static void mergeRunFiles( std::vector<FILE*>& runs, const uint64_t maxRecords, Visitor& visit )
+{
+  std::vector<RunReader> readers;
+  readers.reserve( runs.size() );
+  std::vector<RunReader*> pReaders;
+  for( std::vector<FILE*>::const_iterator it = runs.begin(); it != runs.end(); ++it )
+  {
+    readers.push_back( RunReader( *it ) );
+    pReaders.push_back( &readers.back() );
+  }
+
+  FILE* pMerged = openRunOrDie();
+  {
+    RunMerger merger( pReaders );
+    RunWriter writer( pMerged );
+    for( uint64_t written = 0; written < maxRecords && merger.next(); ++written )
+    {
+      writer.add( merger.term().data(), merger.term().length(), merger.count() );
+      visit( merger.term().data(), merger.term().length(), merger.count() );
+    }
+    finishRunOrDie( writer );
+  }
+  for( std::vector<RunReader>::const_iterator it = readers.begin(); it != readers.end(); ++it )
+  {
+    checkRunOrDie( *it );
+  }
+
+  for( std::vector<FILE*>::const_iterator it = runs.begin(); it != runs.end(); ++it )
+  {
+    fclose( *it );
+  }
+  runs.assign( 1, pMerged );
+}
+
+// rank order as run order: a term's rank key is its count, complemented and big-endian so higher
+// counts come first, then the term. bytewise, keys compare just like TermRankCompare.
+static const size_t kRankKeyPrefix = sizeof( uint64_t );
+
+static void appendRankKey( const std::string& term, const uint64_t count, /*out*/ std::vector<char>& keys )
+{
+  for( int shift = 56; shift >= 0; shift -= 8 )
+  {
+    keys.push_back( static_cast<char>( ~count >> shift ) );
+  }
+  keys.insert( keys.end(), term.begin(), term.end() );
+}
+
+struct ShowRankKey
+{
+  void operator()( const char* key, const size_t length, const uint64_t )
+  {
+    std::cout.write( key + kRankKeyPrefix, length - kRankKeyPrefix ) << '\n';
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SpillingTermCounter
+
+const size_t SpillingTermCounter::kMaxFanIn;
+const size_t SpillingTermCounter::kMinBudgetBytes;
+
+SpillingTermCounter::SpillingTermCounter( const size_t budgetBytes ) :
+  m_tableBudget( 0 ),
+  m_maxTerms( 0 ),
+  m_terms(),
+  m_sorted(),
+  m_runs()
+{
+  // a merge holds a read buffer per run plus the output's write buffer.
+  const size_t mergeBytes = ( kMaxFanIn + 1 ) * kRunBufferBytes;
+  const size_t budget = std::max( budgetBytes, kMinBudgetBytes );
+  m_tableBudget = budget - kProcessBytes - mergeBytes;
+
+  // at S slots the table holds S / 2 terms. the worst moment is growing into S slots, when the
+  // old S / 2 are still there: 1.5 * S slots. (spilling S / 2 terms takes S slots plus S / 2
+  // TermRefs, which is less.)
+  size_t slotCount = 64;
+  while( slotCount * 2 * 3 / 2 * TermTable::slotBytes() <= m_tableBudget )
+    slotCount *= 2;
+  m_maxTerms = slotCount / 2;
+}
+
+SpillingTermCounter::~SpillingTermCounter()
+{
+  for( std::vector<FILE*>::const_iterator it = m_runs.begin(); it != m_runs.end(); ++it )
+  {
+    fclose( *it );
+  }
+}
+
+// writes the table out as a run and empties it.
+void SpillingTermCounter::spill( void )
+{
+  sortTerms( m_terms, m_sorted );
+
+  FILE* pRun = openRunOrDie();
+  RunWriter writer( pRun );
+  for( std::vector<TermRef>::const_iterator it = m_sorted.begin(); it != m_sorted.end(); ++it )
+  {
+    writer.add( it->m_term, it->m_length, it->m_count );
+  }
+  finishRunOrDie( writer );
+  m_runs.push_back( pRun );
+
+  m_sorted.clear();
+  m_terms.clear();
+
+  if( m_runs.size() >= kMaxFanIn )
+    mergeRuns( 0 );
+}
+
+// replaces every run with one run of their merge, offering each merged term to pBest if given.
+void SpillingTermCounter::mergeRuns( CopyingTopKSelector* pBest )
+{
+  static const uint64_t kAll = static_cast<uint64_t>( -1 );
+  if( pBest )
+  {
+    mergeRunFiles( m_runs, kAll, *pBest );
+    return;
+  }
+  IgnoreTerms ignore;
+  mergeRunFiles( m_runs, kAll, ignore );
+}
+
+// shows the best k of the merged run (the only run left) when they don't fit in memory: the run is
+// sorted by rank key the way spill() sorts the table, a budget's worth at a time, and each sorted
+// batch keeps just its best k. merging the batches' runs then gives the best k in order.
+void SpillingTermCounter::showRanked( const unsigned k )
+{
+  // half the budget for the keys, half for the refs that sort them.
+  std::vector<char> keyBytes;
+  keyBytes.reserve( m_tableBudget / 2 );
+  std::vector<TermRef> keys;
+  keys.reserve( m_tableBudget / 2 / sizeof( TermRef ) );
+
+  IgnoreTerms ignore;
+  std::vector<FILE*> ranked;
+  RunReader reader( m_runs[ 0 ] );
+  bool fMore = reader.next();
+  while( fMore )
+  {
+    keyBytes.clear();
+    keys.clear();
+    do
+    {
+      const size_t keyLength = kRankKeyPrefix + reader.term().length();
+      if( !keys.empty() && ( keys.size() == keys.capacity() || keyBytes.size() + keyLength > keyBytes.capacity() ) )
+        break;
+      // a key bigger than the whole batch moves the bytes, so the refs hold offsets for now.
+      keys.push_back( TermRef( 0, keyLength, keyBytes.size() ) );
+      appendRankKey( reader.term(), reader.count(), keyBytes );
+      fMore = reader.next();
+    } while( fMore );
+    for( std::vector<TermRef>::iterator it = keys.begin(); it != keys.end(); ++it )
+    {
+      it->m_term = &keyBytes[ it->m_count ];
+    }
+
+    const size_t keep = std::min<size_t>( k, keys.size() );
+    std::partial_sort( keys.begin(), keys.begin() + keep, keys.end(), TermOrderCompare() );
+    FILE* pRun = openRunOrDie();
+    RunWriter writer( pRun );
+    for( size_t i = 0; i < keep; ++i )
+    {
+      writer.add( keys[ i ].m_term, keys[ i ].m_length, 0 );
+    }
+    finishRunOrDie( writer );
+    ranked.push_back( pRun );
+
+    // one under the usual fan-in: the merge runs alongside the reader above.
+    if( ranked.size() >= kMaxFanIn - 1 )
+      mergeRunFiles( ranked, k, ignore );
+  }
+  checkRunOrDie( reader );
+  rewind( m_runs[ 0 ] );
+
+  ShowRankKey show;
+  mergeRunFiles( ranked, k, show );
+  std::cout.flush();
+  fclose( ranked[ 0 ] );
+}
+
+void SpillingTermCounter::handle( const TermKey& newValue )
+{
+  // spill before the add could grow the table past the budget. (the term may already be in the
+  // table, then this spills a little early, which costs nothing but a shorter run.)
+  if( m_terms.size() >= m_maxTerms || m_terms.memoryUsage() + m_terms.size() * sizeof( TermRef ) >= m_tableBudget )
+    spill();
+  m_terms.add( newValue, 1 );
+}
+
+void SpillingTermCounter::setEntriesRemaining( const unsigned remaining )
+{
+  m_terms.reserve( std::min<size_t>( std::min( remaining, 1u << 16 ), m_maxTerms ) );
+}
+
+void SpillingTermCounter::showKResults( const unsigned k )
+{
+  std::vector<TermRef> best;
+  if( m_runs.empty() )
+  {
+    // everything so far fit in memory.
+    TopKSelector selector( k, m_terms.size() );
+    m_terms.forEach( selector );
+    selector.takeResults( best );
+    showTerms( best );
+    return;
+  }
+
+  if( m_terms.size() > 0 )
+    spill();
+  // the table is empty now, so its memory goes to the best k instead, and the refs that show them.
+  TermTable().swap( m_terms );
+  std::vector<TermRef>().swap( m_sorted );
+  releaseFreedMemory();
+  const size_t resultBytes = static_cast<size_t>( k ) * sizeof( TermRef );
+  if( resultBytes < m_tableBudget )
+  {
+    CopyingTopKSelector selector( k, m_tableBudget - resultBytes );
+    mergeRuns( &selector );
+    if( !selector.overBudget() )
+    {
+      selector.takeResults( best );
+      showTerms( best );
+      return;
+    }
+  }
+  else
+  {
+    mergeRuns( 0 );
+  }
+  releaseFreedMemory();
+  showRanked( k );
+}
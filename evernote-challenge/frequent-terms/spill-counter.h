@@ -0,0 +1,53 @@
+// spill-counter.h: "frequent-terms -spill <megabytes>" counts exactly in bounded memory, for inputs
+//  with more distinct terms than fit in RAM.
+//
+//  terms are counted in a TermTable capped at what the budget allows. when it's full its terms
+//  are sorted and written out as a run (see term-runs.h), and the table is emptied and reused.
+//  a top-k query writes out what's in the table, then streams a k-way merge of every run: equal
+//  terms meet in the merge and their counts add up, and the best k are kept on the way past, in
+//  the memory the (now empty) table had. if k is too big for that, the merged terms are sorted
+//  again on disk, into rank order this time, and the first k streamed out (see showRanked).
+//  the merged stream is also written as a single new run that replaces the ones it came from, so
+//  the next query starts from there. runs are merged the same way whenever there get to be
+//  kMaxFanIn of them, which bounds the number of files (and read buffers) open at once.
+//
+//  the budget covers the whole process: the table (or a query's best k), the sort, the merge
+//  buffers and a fixed allowance for everything else. if nothing was ever spilled a query works on
+//  the table directly, just like the default mode.
+#ifndef SPILL_COUNTER_H
+#define SPILL_COUNTER_H
+
+#include <cstdio>
+#include <vector>
+
+#include "term-counter.h"
+#include "term-table.h"
+#include "top-k-selector.h"
+
+class SpillingTermCounter : public TermCounter
+{
+  static const size_t kMaxFanIn = 16;
+
+  size_t               m_tableBudget;  // bytes for the table plus the sort that spills it
+  size_t               m_maxTerms;     // table capacity within m_tableBudget
+  TermTable            m_terms;
+  std::vector<TermRef> m_sorted;       // m_terms in term order, while spilling
+  std::vector<FILE*>   m_runs;
+
+  void spill( void );
+  void mergeRuns( CopyingTopKSelector* pBest );
+  void showRanked( const unsigned k );
+
+public:
+  // the smallest budget this will take.
+  static const size_t kMinBudgetBytes = 8 << 20;
+
+  SpillingTermCounter( const size_t budgetBytes );
+  ~SpillingTermCounter();
+
+  void handle( const TermKey& newValue );
+  void setEntriesRemaining( const unsigned remaining );
+  void showKResults( const unsigned k );
+};
+
+#endif // SPILL_COUNTER_H
@@ -0,0 +1,207 @@
+// stream-summary.cpp: frequency-bucket term ranking (see stream-summary.h)
+#include "stream-summary.h"
+
+#include <iostream>
+#include <algorithm>
+
+const uint32_t StreamSummaryCounter::kNone;
+
+StreamSummaryCounter::StreamSummaryCounter() :
+  m_ids(),
+  m_terms(),
+  m_buckets(),
+  m_freeBuckets(),
+  m_top( kNone ),
+  m_bottom( kNone ),
+  m_text()
+{
+}
+
+// makes an empty bucket and links it in between higher and lower (either may be kNone).
+uint32_t StreamSummaryCounter::newBucket( const uint64_t count, const uint32_t higher, const uint32_t lower )
+{
+  uint32_t bucket = m_buckets.size();
+  if( !m_freeBuckets.empty() )
+  {
+    bucket = m_freeBuckets.back();
+    m_freeBuckets.pop_back();
+  }
+  else
+  {
+    m_buckets.push_back( Bucket() );
+  }
+
+  Bucket& b = m_buckets[ bucket ];
+  b.m_count = count;
+  b.m_first = kNone;
+  b.m_last = kNone;
+  b.m_higher = higher;
+  b.m_lower = lower;
+  b.m_pending.clear();
+  b.m_heapSize = 0;
+  b.m_pendingCount = 0;
+  if( higher != kNone )
+    m_buckets[ higher ].m_lower = bucket;
+  else
+    m_top = bucket;
+  if( lower != kNone )
+    m_buckets[ lower ].m_higher = bucket;
+  else
+    m_bottom = bucket;
+  return bucket;
+}
+
+void StreamSummaryCounter::freeBucket( const uint32_t bucket )
+{
+  const Bucket& b = m_buckets[ bucket ];
+  if( b.m_higher != kNone )
+    m_buckets[ b.m_higher ].m_lower = b.m_lower;
+  else
+    m_top = b.m_lower;
+  if( b.m_lower != kNone )
+    m_buckets[ b.m_lower ].m_higher = b.m_higher;
+  else
+    m_bottom = b.m_higher;
+  m_freeBuckets.push_back( bucket );
+}
+
+// a term arriving in a bucket waits on m_pending; settleBucket moves it to the list when a query
+// gets that far.
+void StreamSummaryCounter::addTerm( const uint32_t id, const uint32_t bucket )
+{
+  Bucket& b = m_buckets[ bucket ];
+  Term& term = m_terms[ id ];
+  term.m_bucket = bucket;
+  term.m_fPending = true;
+  ++b.m_pendingCount;
+
+  // terms that moved on are only dropped when they surface; don't let them pile up.
+  if( b.m_pending.size() >= 64 && b.m_pending.size() >= 2 * b.m_pendingCount )
+  {
+    std::vector<uint32_t>::iterator live = b.m_pending.begin();
+    for( std::vector<uint32_t>::const_iterator it = b.m_pending.begin(); it != b.m_pending.end(); ++it )
+    {
+      if( m_terms[ *it ].m_bucket == bucket )
+        *live++ = *it;
+    }
+    b.m_pending.erase( live, b.m_pending.end() );
+    b.m_heapSize = 0;
+  }
+  b.m_pending.push_back( id );
+}
+
+// links the term into the bucket's list, in front of next (kNone: at the end).
+void StreamSummaryCounter::linkTerm( const uint32_t id, const uint32_t bucket, const uint32_t next )
+{
+  Bucket& b = m_buckets[ bucket ];
+  Term& term = m_terms[ id ];
+  term.m_bucket = bucket;
+  term.m_fPending = false;
+  term.m_prev = next != kNone ? m_terms[ next ].m_prev : b.m_last;
+  term.m_next = next;
+  if( term.m_prev != kNone )
+    m_terms[ term.m_prev ].m_next = id;
+  else
+    b.m_first = id;
+  if( next != kNone )
+    m_terms[ next ].m_prev = id;
+  else
+    b.m_last = id;
+}
+
+void StreamSummaryCounter::unlinkTerm( const uint32_t id )
+{
+  const Term& term = m_terms[ id ];
+  Bucket& b = m_buckets[ term.m_bucket ];
+  if( term.m_fPending )
+  {
+    // still on the heap, where it goes stale.
+    --b.m_pendingCount;
+    return;
+  }
+  if( term.m_prev != kNone )
+    m_terms[ term.m_prev ].m_next = term.m_next;
+  else
+    b.m_first = term.m_next;
+  if( term.m_next != kNone )
+    m_terms[ term.m_next ].m_prev = term.m_prev;
+  else
+    b.m_last = term.m_prev;
+}
+
+void StreamSummaryCounter::handle( const TermKey& newValue )
+{
+  m_text.assign( newValue.m_term, newValue.m_length );
+  IdMap::iterator it = m_ids.find( m_text );
+  if( it == m_ids.end() )
+  {
+    // new term, count 1: the bottom bucket if that's the 1 bucket, else a new bottom.
+    const uint32_t id = m_terms.size();
+    it = m_ids.insert( IdMap::value_type( m_text, id ) ).first;
+    m_terms.push_back( Term() );
+    m_terms[ id ].m_text = &it->first;
+    const uint32_t bucket = ( m_bottom != kNone && m_buckets[ m_bottom ].m_count == 1 ) ? m_bottom : newBucket( 1, m_bottom, kNone );
+    addTerm( id, bucket );
+    return;
+  }
+
+  const uint32_t id = it->second;
+  const uint32_t from = m_terms[ id ].m_bucket;
+  const uint64_t count = m_buckets[ from ].m_count + 1;
+  const uint32_t higher = m_buckets[ from ].m_higher;
+  const uint32_t to = ( higher != kNone && m_buckets[ higher ].m_count == count ) ? higher : newBucket( count, higher, from );
+
+  unlinkTerm( id );
+  if( m_buckets[ from ].m_first == kNone && m_buckets[ from ].m_pendingCount == 0 )
+    freeBucket( from );
+  addTerm( id, to );
+}
+
+// merges pending terms into the bucket's list until its first count terms are the bucket's count
+// smallest. what's left on the heap sorts after all of them, so the list stays in order.
+void StreamSummaryCounter::settleBucket( const uint32_t bucket, const unsigned count )
+{
+  Bucket& b = m_buckets[ bucket ];
+  const TextAfter after( m_terms );
+  for( ; b.m_heapSize < b.m_pending.size(); ++b.m_heapSize )
+    std::push_heap( b.m_pending.begin(), b.m_pending.begin() + b.m_heapSize + 1, after );
+
+  uint32_t next = b.m_first;
+  for( unsigned settled = 0; settled < count; ++settled )
+  {
+    while( !b.m_pending.empty() && m_terms[ b.m_pending.front() ].m_bucket != bucket )
+    {
+      std::pop_heap( b.m_pending.begin(), b.m_pending.end(), after );
+      b.m_pending.pop_back();
+      --b.m_heapSize;
+    }
+
+    if( !b.m_pending.empty() && ( next == kNone || after( next, b.m_pending.front() ) ) )
+    {
+      const uint32_t id = b.m_pending.front();
+      std::pop_heap( b.m_pending.begin(), b.m_pending.end(), after );
+      b.m_pending.pop_back();
+      --b.m_heapSize;
+      --b.m_pendingCount;
+      linkTerm( id, bucket, next );
+    }
+    else if( next != kNone )
+      next = m_terms[ next ].m_next;
+    else
+      break;
+  }
+}
+
+void StreamSummaryCounter::showKResults( const unsigned k )
+{
+  unsigned displayCount = 0;
+  for( uint32_t bucket = m_top; bucket != kNone && displayCount < k; bucket = m_buckets[ bucket ].m_lower )
+  {
+    settleBucket( bucket, k - displayCount );
+    for( uint32_t id = m_buckets[ bucket ].m_first; id != kNone && displayCount < k; id = m_terms[ id ].m_next, ++displayCount )
+    {
+      std::cout << *m_terms[ id ].m_text << '\n';
+    }
+  }
+  std::cout.flush();
+}
@@ -0,0 +1,87 @@
+// stream-summary.h: "frequent-terms -summary" keeps the terms sorted by count as they arrive, for
+//  inputs that interleave queries with more terms ("A <M>" lines, see InputParser).
+//
+//  terms with the same count share a bucket, and the buckets form a list ordered by count, highest
+//  first. a term's count only ever goes up by one, so an increment moves the term from its bucket
+//  to the neighbor above (creating it if the next count up isn't there yet): O(1), no search.
+//  a query walks buckets from the top and stops after k terms.
+//
+//  within a bucket, terms must come out in lexicographical order. a bucket keeps a sorted term
+//  list, plus a min-heap (by text) of the terms that arrived since: an increment just appends to
+//  the bucket it lands in, and a query pushes what arrived since onto the heap, O(1) each on
+//  average. it then merges only as many heap terms into the list as it prints from the bucket, so
+//  beyond the new arrivals it costs O(k log m) for heaps of m terms, however big the buckets (the
+//  count-1 bucket, usually) get.
+#ifndef STREAM_SUMMARY_H
+#define STREAM_SUMMARY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "term-counter.h"
+
+class StreamSummaryCounter : public TermCounter
+{
+  static const uint32_t kNone = 0xffffffff;
+
+  struct Term
+  {
+    const std::string* m_text;  // the key in m_ids, which stays put through rehashes
+    uint32_t           m_bucket;
+    uint32_t           m_prev;  // neighbors within the bucket
+    uint32_t           m_next;
+    bool               m_fPending;  // in the bucket's heap, not its list yet
+  };
+
+  struct Bucket
+  {
+    uint64_t m_count;
+    uint32_t m_first;   // term list
+    uint32_t m_last;
+    uint32_t m_higher;  // neighbors in the bucket list
+    uint32_t m_lower;
+
+    // terms that arrived since the last query read this far: a heap, smallest text on top, up to
+    // m_heapSize and the latest arrivals after that. terms that moved on to the next bucket up are
+    // left in and dropped when they surface.
+    std::vector<uint32_t> m_pending;
+    uint32_t              m_heapSize;
+    uint32_t              m_pendingCount;  // the ones still here
+  };
+
+  // heap order for Bucket::m_pending.
+  struct TextAfter
+  {
+    const std::vector<Term>& m_terms;
+    TextAfter( const std::vector<Term>& _terms ) : m_terms( _terms ) {}
+    bool operator()( const uint32_t lhs, const uint32_t rhs ) const { return *m_terms[ rhs ].m_text < *m_terms[ lhs ].m_text; }
+  };
+
+  typedef std::unordered_map<std::string, uint32_t> IdMap;
+
+  IdMap                 m_ids;
+  std::vector<Term>     m_terms;    // by id
+  std::vector<Bucket>   m_buckets;  // by index, recycled through m_freeBuckets
+  std::vector<uint32_t> m_freeBuckets;
+  uint32_t              m_top;      // highest count bucket
+  uint32_t              m_bottom;   // lowest count bucket
+  std::string           m_text;     // for lookups, reused so it keeps its capacity
+
+  uint32_t newBucket( const uint64_t count, const uint32_t higher, const uint32_t lower );
+  void     freeBucket( const uint32_t bucket );
+  void     addTerm( const uint32_t id, const uint32_t bucket );
+  void     linkTerm( const uint32_t id, const uint32_t bucket, const uint32_t next );
+  void     unlinkTerm( const uint32_t id );
+  void     settleBucket( const uint32_t bucket, const unsigned count );
+
+public:
+  StreamSummaryCounter();
+
+  void handle( const TermKey& newValue );
+  void setEntriesRemaining( const unsigned remaining ) {}
+  void showKResults( const unsigned k );
+};
+
+#endif // STREAM_SUMMARY_H
@@ -0,0 +1,20 @@
+// term-counter.h: what the frequent-terms commands drive. TermCountMap (frequent-terms.cpp) is
+//  the exact counter; other modes count differently behind the same interface.
+#ifndef TERM_COUNTER_H
+#define TERM_COUNTER_H
+
+#include "term-table.h"  // TermKey
+
+class TermCounter
+{
+public:
+  virtual ~TermCounter() {}
+
+  // newValue is already trimmed and hashed (see term-normalize.h). its view of the term is only
+  // good for the duration of the call.
+  virtual void handle( const TermKey& newValue ) = 0;
+  virtual void setEntriesRemaining( const unsigned remaining ) = 0;
+  virtual void showKResults( const unsigned k ) = 0;
+};
+
+#endif // TERM_COUNTER_H
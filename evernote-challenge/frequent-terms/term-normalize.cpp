@@ -0,0 +1,218 @@
+// term-normalize.cpp: scalar, SSE2 and AVX2 term normalization kernels (see term-normalize.h)
+#include "term-normalize.h"
+
+#include <algorithm>
+#include <string>
+#include <cstring>  // memcpy
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define TERM_NORMALIZE_X86 1
+#endif
+
+typedef void ( *NormalizeKernel )( const char* begin, const char* end, const char* readLimit, /*out*/ TermKey& key );
+typedef uint32_t ( *SpaceMaskKernel )( const char* block );
+
+static void normalizeScalar( const char* begin, const char* end, const char* readLimit, /*out*/ TermKey& key )
+{
+  trimTerm( begin, end );
+  key.set( begin, end - begin );
+}
+
+// the whitespace bits of a 32-byte block.
+static uint32_t spaceMaskScalar( const char* block )
+{
+  uint32_t mask = 0;
+  for( unsigned i = 0; i < 32; ++i )
+  {
+    mask |= static_cast<uint32_t>( isTermSpace( block[ i ] ) ) << i;
+  }
+  return mask;
+}
+
+#ifdef TERM_NORMALIZE_X86
+
+// lines the vector kernels take whole.
+static const size_t kVectorLine = 32;
+
+static bool fitsVector( const char* begin, const char* end, const char* readLimit )
+{
+  return static_cast<size_t>( end - begin ) <= kVectorLine && readLimit - begin >= static_cast<ptrdiff_t>( kVectorLine );
+}
+
+// common tail of the vector kernels. staged holds the line's first 32 bytes followed by 32 zero
+// bytes, spaceMask has a bit set for each whitespace byte among them.
+static void finishKey( const char* begin, const size_t length, const char* staged, const uint32_t spaceMask, /*out*/ TermKey& key )
+{
+  const uint32_t lineBits = length == kVectorLine ? 0xffffffffu : ( ( 1u << length ) - 1 );
+  const uint32_t termBits = ~spaceMask & lineBits;
+  if( termBits == 0 )
+  {
+    key.set( begin, 0 );
+    return;
+  }
+  const unsigned lead = __builtin_ctz( termBits );
+  const unsigned termLength = 32 - __builtin_clz( termBits ) - lead;
+
+  // the key is the term's first (up to) 24 bytes, zero-padded: shift by reloading from lead, then
+  // mask each word down to the bytes that belong to the term. zeroBytes picks up any '\0' among
+  // the kept bytes (the usual has-a-zero-byte trick, with the masked-off bytes forced nonzero).
+  const size_t keep = std::min<size_t>( termLength, TermKey::kInlineBytes );
+  uint64_t words[ 3 ];
+  uint64_t zeroBytes = 0;
+  memcpy( words, staged + lead, sizeof( words ) );
+  for( size_t i = 0; i < 3; ++i )
+  {
+    const size_t bytesHere = keep > i * 8 ? std::min<size_t>( keep - i * 8, 8 ) : 0;
+    const uint64_t keepMask = bytesHere == 8 ? ~0ull : ( ( 1ull << ( bytesHere * 8 ) ) - 1 );
+    const uint64_t filled = words[ i ] | ~keepMask;
+    zeroBytes |= ( filled - 0x0101010101010101ull ) & ~filled & 0x8080808080808080ull;
+    words[ i ] &= keepMask;
+  }
+  memcpy( key.m_padded, words, sizeof( words ) );
+  key.m_hash = TermKey::hashPadded( key.m_padded );
+  key.m_fInline = termLength <= TermKey::kInlineBytes && zeroBytes == 0;
+  key.m_term = begin + lead;
+  key.m_length = termLength;
+}
+
+static uint32_t spaceMaskSse2( const char* block )
+{
+  const __m128i tab = _mm_set1_epi8( '\t' );
+  const __m128i controlRange = _mm_set1_epi8( '\r' - '\t' );
+  const __m128i space = _mm_set1_epi8( ' ' );
+  uint32_t spaceMask = 0;
+  for( size_t half = 0; half < 2; ++half )
+  {
+    const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( block + half * 16 ) );
+    // '\t'..'\r' is an unsigned range check: subtract the bottom, compare against the width.
+    const __m128i offset = _mm_sub_epi8( bytes, tab );
+    const __m128i isControl = _mm_cmpeq_epi8( _mm_min_epu8( offset, controlRange ), offset );
+    const __m128i isSpace = _mm_or_si128( isControl, _mm_cmpeq_epi8( bytes, space ) );
+    spaceMask |= static_cast<uint32_t>( _mm_movemask_epi8( isSpace ) ) << ( half * 16 );
+  }
+  return spaceMask;
+}
+
+static void normalizeSse2( const char* begin, const char* end, const char* readLimit, /*out*/ TermKey& key )
+{
+  if( !fitsVector( begin, end, readLimit ) )
+  {
+    normalizeScalar( begin, end, readLimit, key );
+    return;
+  }
+
+  alignas( 16 ) char staged[ 64 ];
+  const uint32_t spaceMask = spaceMaskSse2( begin );
+  for( size_t half = 0; half < 2; ++half )
+  {
+    _mm_store_si128( reinterpret_cast<__m128i*>( staged + half * 16 ), _mm_loadu_si128( reinterpret_cast<const __m128i*>( begin + half * 16 ) ) );
+    _mm_store_si128( reinterpret_cast<__m128i*>( staged + 32 + half * 16 ), _mm_setzero_si128() );
+  }
+  finishKey( begin, end - begin, staged, spaceMask, key );
+}
+
+__attribute__(( target( "avx2" ) ))
+static uint32_t spaceMaskOf( const __m256i bytes )
+{
+  const __m256i offset = _mm256_sub_epi8( bytes, _mm256_set1_epi8( '\t' ) );
+  const __m256i isControl = _mm256_cmpeq_epi8( _mm256_min_epu8( offset, _mm256_set1_epi8( '\r' - '\t' ) ), offset );
+  const __m256i isSpace = _mm256_or_si256( isControl, _mm256_cmpeq_epi8( bytes, _mm256_set1_epi8( ' ' ) ) );
+  return _mm256_movemask_epi8( isSpace );
+}
+
+__attribute__(( target( "avx2" ) ))
+static uint32_t spaceMaskAvx2( const char* block )
+{
+  return spaceMaskOf( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( block ) ) );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void normalizeAvx2( const char* begin, const char* end, const char* readLimit, /*out*/ TermKey& key )
+{
+  if( !fitsVector( begin, end, readLimit ) )
+  {
+    normalizeScalar( begin, end, readLimit, key );
+    return;
+  }
+
+  const __m256i bytes = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( begin ) );
+  const uint32_t spaceMask = spaceMaskOf( bytes );
+
+  alignas( 32 ) char staged[ 64 ];
+  _mm256_store_si256( reinterpret_cast<__m256i*>( staged ), bytes );
+  _mm256_store_si256( reinterpret_cast<__m256i*>( staged + 32 ), _mm256_setzero_si256() );
+  finishKey( begin, end - begin, staged, spaceMask, key );
+}
+
+#endif // TERM_NORMALIZE_X86
+
+///////////////
+
+static const char*     s_kernelName = "scalar";
+static NormalizeKernel s_kernel = normalizeScalar;
+static SpaceMaskKernel s_spaceMask = spaceMaskScalar;
+
+// picks the widest kernel this cpu runs, before main.
+static bool s_fKernelPicked = []()
+{
+#ifdef TERM_NORMALIZE_X86
+  if( __builtin_cpu_supports( "avx2" ) )
+    return selectNormalizeKernel( "avx2" );
+  return selectNormalizeKernel( "sse2" );
+#else
+  return true;
+#endif
+}();
+
+bool selectNormalizeKernel( const char* name )
+{
+  const std::string kernel( name );
+  if( kernel == "scalar" )
+  {
+    s_kernelName = "scalar";
+    s_kernel = normalizeScalar;
+    s_spaceMask = spaceMaskScalar;
+    return true;
+  }
+#ifdef TERM_NORMALIZE_X86
+  if( kernel == "sse2" )
+  {
+    s_kernelName = "sse2";
+    s_kernel = normalizeSse2;
+    s_spaceMask = spaceMaskSse2;
+    return true;
+  }
+  if( kernel == "avx2" && __builtin_cpu_supports( "avx2" ) )
+  {
+    s_kernelName = "avx2";
+    s_kernel = normalizeAvx2;
+    s_spaceMask = spaceMaskAvx2;
+    return true;
+  }
+#endif
+  return false;
+}
+
+const char* normalizeKernelName( void )
+{
+  return s_kernelName;
+}
+
+void normalizeTerm( const char* begin, const char* end, const char* readLimit, /*out*/ TermKey& key )
+{
+  s_kernel( begin, end, readLimit, key );
+}
+
+void markTermSpace( const char* begin, const char* end, /*out*/ std::vector<uint32_t>& bits )
+{
+  const size_t length = end - begin;
+  bits.resize( ( length + 31 ) / 32 );
+  for( size_t w = 0; w < bits.size(); ++w )
+  {
+    bits[ w ] = s_spaceMask( begin + w * 32 );
+  }
+  // whatever follows end counts as whitespace.
+  if( length % 32 != 0 )
+    bits.back() |= ~0u << ( length % 32 );
+}
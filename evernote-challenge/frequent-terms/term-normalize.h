@@ -0,0 +1,49 @@
+// term-normalize.h: turn a raw input line into the term it counts as (trimmed of surrounding
+//  whitespace, as isspace sees it in the "C" locale) and its TermKey, in one pass.
+//
+//  a line of up to 32 bytes (nearly all of them: terms are under 25 chars) is classified with one
+//  AVX2 compare, or two SSE2 ones, instead of a byte at a time. the trimmed bounds come off the
+//  movemask bits, and the same register, shifted to the term start and masked, is the padded key
+//  that gets hashed. the widest kernel the cpu supports is picked once at startup; longer lines,
+//  lines too close to readLimit and non-x86 builds use the scalar path. "-kernel <name>" overrides
+//  the pick, for benchmarking. markTermSpace runs the same classification over a whole line, a
+//  block at a time, for splitting free text into words (see text-ingest.h).
+#ifndef TERM_NORMALIZE_H
+#define TERM_NORMALIZE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "term-table.h"  // TermKey
+
+// isspace in the "C" locale, without the locale lookup.
+inline bool isTermSpace( const char c )
+{
+  return c == ' ' || ( c >= '\t' && c <= '\r' );
+}
+
+// narrows [begin, end) to the term inside it.
+inline void trimTerm( /*inout*/ const char*& begin, /*inout*/ const char*& end )
+{
+  while( begin != end && isTermSpace( *begin ) )
+    ++begin;
+  while( end != begin && isTermSpace( end[ -1 ] ) )
+    --end;
+}
+
+// the line is [begin, end); bytes up to readLimit may be read (and ignored) past its end.
+// key.m_term ends up pointing into the line.
+void normalizeTerm( const char* begin, const char* end, const char* readLimit, /*out*/ TermKey& key );
+
+// marks the whitespace in [begin, end): bit i of bits[ w ] is set if begin[ w * 32 + i ] is
+// whitespace, and so are the bits past end in the last word. may read up to 31 bytes past end.
+void markTermSpace( const char* begin, const char* end, /*out*/ std::vector<uint32_t>& bits );
+
+// switches normalizeTerm and markTermSpace to the named kernel ("avx2", "sse2" or "scalar"). false if this
+// build or cpu can't run it.
+bool selectNormalizeKernel( const char* name );
+
+// which kernel normalizeTerm and markTermSpace use.
+const char* normalizeKernelName( void );
+
+#endif // TERM_NORMALIZE_H
@@ -0,0 +1,256 @@
+// term-runs.cpp: run files and their merge (see term-runs.h)
+#include "term-runs.h"
+
+#include <algorithm>
+#include <cstdlib>   // getenv
+#include <cstring>   // memcpy
+#include <unistd.h>  // mkstemp, unlink, close
+
+void sortTerms( const TermTable& terms, /*out*/ std::vector<TermRef>& sorted )
+{
+  struct Collect
+  {
+    std::vector<TermRef>& m_refs;
+    void operator()( const char* term, const size_t length, const uint64_t count ) { m_refs.push_back( TermRef( term, length, count ) ); }
+  } collect = { sorted };
+
+  sorted.clear();
+  sorted.reserve( terms.size() );
+  terms.forEach( collect );
+  std::sort( sorted.begin(), sorted.end(), TermOrderCompare() );
+}
+
+FILE* openRunFile( void )
+{
+  const char* dir = getenv( "TMPDIR" );
+  std::string path( dir && *dir ? dir : "/tmp" );
+  path += "/frequent-terms-run-XXXXXX";
+  std::vector<char> name( path.begin(), path.end() );
+  name.push_back( '\0' );
+
+  const int fd = mkstemp( &name[ 0 ] );
+  if( fd < 0 )
+    return 0;
+  // unlinked right away, the space comes back when the file is closed (or the process dies).
+  unlink( &name[ 0 ] );
+  FILE* pFile = fdopen( fd, "w+b" );
+  if( !pFile )
+    close( fd );
+  return pFile;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RunWriter
+
+RunWriter::RunWriter( FILE* _pFile ) :
+  m_pFile( _pFile ),
+  m_buf( kRunBufferBytes ),
+  m_used( 0 ),
+  m_prev()
+{
+}
+
+void RunWriter::flushBuffer( void )
+{
+  fwrite( &m_buf[ 0 ], 1, m_used, m_pFile );
+  m_used = 0;
+}
+
+void RunWriter::putVarint( unsigned long long value )
+{
+  while( value >= 0x80 )
+  {
+    m_buf[ m_used++ ] = static_cast<char>( ( value & 0x7f ) | 0x80 );
+    value >>= 7;
+  }
+  m_buf[ m_used++ ] = static_cast<char>( value );
+}
+
+void RunWriter::add( const char* term, const size_t length, const uint64_t count )
+{
+  size_t shared = 0;
+  const size_t most = std::min( length, m_prev.length() );
+  while( shared < most && term[ shared ] == m_prev[ shared ] )
+    ++shared;
+  m_prev.replace( shared, std::string::npos, term + shared, length - shared );
+
+  // two varints are at most 20 bytes.
+  if( m_used + 20 > m_buf.size() )
+    flushBuffer();
+  putVarint( shared );
+  putVarint( length - shared );
+
+  size_t written = shared;
+  while( written < length )
+  {
+    if( m_used == m_buf.size() )
+      flushBuffer();
+    const size_t chunk = std::min( length - written, m_buf.size() - m_used );
+    memcpy( &m_buf[ m_used ], term + written, chunk );
+    m_used += chunk;
+    written += chunk;
+  }
+
+  if( m_used + 10 > m_buf.size() )
+    flushBuffer();
+  putVarint( count );
+}
+
+bool RunWriter::finish( void )
+{
+  flushBuffer();
+  const bool fOk = fflush( m_pFile ) == 0 && !ferror( m_pFile );
+  rewind( m_pFile );
+  return fOk;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RunReader
+
+RunReader::RunReader( FILE* _pFile ) :
+  m_pFile( _pFile ),
+  m_buf( kRunBufferBytes ),
+  m_pos( 0 ),
+  m_end( 0 ),
+  m_term(),
+  m_count( 0 ),
+  m_records( 0 ),
+  m_fBad( false )
+{
+}
+
+RunReader::RunReader( const char* begin, const char* end ) :
+  m_pFile( 0 ),
+  m_buf(),
+  m_pos( begin ),
+  m_end( end ),
+  m_term(),
+  m_count( 0 ),
+  m_records( 0 ),
+  m_fBad( false )
+{
+}
+
+// called with the buffer used up. false at the end of the run.
+bool RunReader::refill( void )
+{
+  if( !m_pFile )
+    return false;
+  const size_t read = fread( &m_buf[ 0 ], 1, m_buf.size(), m_pFile );
+  m_pos = &m_buf[ 0 ];
+  m_end = m_pos + read;
+  return read > 0;
+}
+
+bool RunReader::getByte( /*out*/ unsigned char& byte )
+{
+  if( m_pos == m_end && !refill() )
+    return false;
+  byte = static_cast<unsigned char>( *m_pos++ );
+  return true;
+}
+
+bool RunReader::getVarint( /*out*/ unsigned long long& value )
+{
+  value = 0;
+  unsigned shift = 0;
+  unsigned char byte;
+  do
+  {
+    if( !getByte( byte ) || shift > 63 )
+      return false;
+    value |= static_cast<unsigned long long>( byte & 0x7f ) << shift;
+    shift += 7;
+  } while( byte & 0x80 );
+  return true;
+}
+
+bool RunReader::next( void )
+{
+  // a clean end is the run running out right at a record boundary.
+  if( m_fBad || ( m_pos == m_end && !refill() ) )
+    return false;
+
+  // from here on, anything short of a whole record in order is a bad run. in memory the suffix
+  // can be checked against what's left, so a garbled length can't ask for a huge term.
+  m_fBad = true;
+  unsigned long long shared;
+  unsigned long long suffix;
+  if( !getVarint( shared ) || shared > m_term.length() || !getVarint( suffix ) || ( !m_pFile && suffix > static_cast<size_t>( m_end - m_pos ) ) )
+    return false;
+
+  // terms increase: past the first record, the first byte after the shared prefix must go up (or
+  // the previous term ended there and this one carries on).
+  const bool fFirst = m_records == 0;
+  const int prevNext = shared < m_term.length() ? static_cast<unsigned char>( m_term[ shared ] ) : -1;
+
+  // the shared prefix is already in m_term.
+  m_term.resize( shared + suffix );
+  size_t read = shared;
+  while( read < m_term.length() )
+  {
+    if( m_pos == m_end && !refill() )
+      return false;
+    const size_t chunk = std::min<size_t>( m_term.length() - read, m_end - m_pos );
+    memcpy( &m_term[ read ], m_pos, chunk );
+    m_pos += chunk;
+    read += chunk;
+  }
+
+  if( !fFirst && ( suffix == 0 || static_cast<unsigned char>( m_term[ shared ] ) <= prevNext ) )
+    return false;
+
+  unsigned long long count;
+  if( !getVarint( count ) )
+    return false;
+  m_count = count;
+  ++m_records;
+  m_fBad = false;
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RunMerger
+
+// for std::*_heap, which keeps the greatest on top: so "greater term" puts the least on top.
+static bool laterTerm( const RunReader* lhs, const RunReader* rhs )
+{
+  return lhs->term() > rhs->term();
+}
+
+RunMerger::RunMerger( const std::vector<RunReader*>& readers ) :
+  m_heap(),
+  m_term(),
+  m_count( 0 )
+{
+  for( std::vector<RunReader*>::const_iterator it = readers.begin(); it != readers.end(); ++it )
+  {
+    if( ( *it )->next() )
+      m_heap.push_back( *it );
+  }
+  std::make_heap( m_heap.begin(), m_heap.end(), laterTerm );
+}
+
+bool RunMerger::next( void )
+{
+  if( m_heap.empty() )
+    return false;
+
+  m_term = m_heap.front()->term();
+  m_count = 0;
+  // a term is in each run at most once, so every reader holding it is at it now.
+  while( !m_heap.empty() && m_heap.front()->term() == m_term )
+  {
+    std::pop_heap( m_heap.begin(), m_heap.end(), laterTerm );
+    RunReader* pReader = m_heap.back();
+    m_count += pReader->count();
+    if( pReader->next() )
+      std::push_heap( m_heap.begin(), m_heap.end(), laterTerm );
+    else
+      m_heap.pop_back();
+  }
+  return true;
+}
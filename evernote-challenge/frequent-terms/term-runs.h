@@ -0,0 +1,106 @@
+// term-runs.h: sorted (term, count) runs, and a streaming k-way merge of them.
+//  a run is a sequence of records in increasing term order (bytewise, like memcmp), each
+//      varint bytes shared with the previous term, varint suffix length, the suffix, varint count
+//  where a varint is 7 bits per byte, low bits first, high bit set on all but the last byte.
+//  counts are 64 bits all the way through: summed across runs (or machines) they can outgrow 32.
+//  sorted terms share long prefixes, so most records are a few bytes. runs are written and read
+//  strictly front to back, through a fixed-size buffer for files, so however big a run is,
+//  reading or writing one costs kRunBufferBytes of memory. a run already in memory (a mapped
+//  snapshot, say) is read in place.
+#ifndef TERM_RUNS_H
+#define TERM_RUNS_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "term-table.h"
+#include "top-k-selector.h"  // TermRef
+
+static const size_t kRunBufferBytes = 1 << 16;
+
+// the table's terms in run order. they point into the table.
+void sortTerms( const TermTable& terms, /*out*/ std::vector<TermRef>& sorted );
+
+// an anonymous temp file (in $TMPDIR, else /tmp) that goes away when closed. 0 on failure.
+FILE* openRunFile( void );
+
+///////////////
+
+class RunWriter
+{
+  FILE*             m_pFile;
+  std::vector<char> m_buf;
+  size_t            m_used;
+  std::string       m_prev;  // the last term written
+
+  void putVarint( unsigned long long value );
+  void flushBuffer( void );
+
+public:
+  // writes at the file's current position.
+  RunWriter( FILE* _pFile );
+
+  // terms must come in increasing order, each once.
+  void add( const char* term, const size_t length, const uint64_t count );
+
+  // flushes, and rewinds the file for reading. false if a write failed (disk full, say).
+  bool finish( void );
+};
+
+///////////////
+
+class RunReader
+{
+  FILE*             m_pFile;  // 0 when reading from memory
+  std::vector<char> m_buf;
+  const char*       m_pos;
+  const char*       m_end;
+  std::string       m_term;
+  uint64_t          m_count;
+  uint64_t          m_records;  // read so far
+  bool              m_fBad;
+
+  bool refill( void );
+  bool getByte( /*out*/ unsigned char& byte );
+  bool getVarint( /*out*/ unsigned long long& value );
+
+public:
+  // reads from the file's current position. the reader doesn't own the file.
+  RunReader( FILE* _pFile );
+
+  // reads the run held in [begin, end), which must outlive the reader.
+  RunReader( const char* begin, const char* end );
+
+  // steps to the next record. false at the end of the run, or at a record that's cut short or
+  // out of order, which also sets bad().
+  bool next( void );
+
+  const std::string& term( void ) const { return m_term; }
+  uint64_t           count( void ) const { return m_count; }
+  uint64_t           records( void ) const { return m_records; }
+  bool               bad( void ) const { return m_fBad; }
+};
+
+///////////////
+
+// merges runs into one increasing stream of distinct terms, adding up the counts of a term found
+// in several runs. memory is the readers' buffers plus a heap of one entry per run.
+class RunMerger
+{
+  std::vector<RunReader*> m_heap;  // readers with a current record, least term on top
+  std::string             m_term;
+  uint64_t                m_count;
+
+public:
+  // the readers must be fresh (next() not called yet); they're not owned.
+  RunMerger( const std::vector<RunReader*>& readers );
+
+  bool next( void );
+
+  const std::string& term( void ) const { return m_term; }
+  uint64_t           count( void ) const { return m_count; }
+};
+
+#endif // TERM_RUNS_H
@@ -0,0 +1,186 @@
+// term-snapshot.cpp: writing and merging count snapshots (see term-snapshot.h)
+#include "term-snapshot.h"
+
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <cstdio>   // rename, remove
+#include <cstring>  // memcmp, memcpy
+#include <stdint.h>
+
+#include "input-buffer.h"
+#include "term-runs.h"
+#include "complete-index.h"
+#include "top-k-selector.h"
+
+static const char   kMagic[ 8 ] = { 'F', 'T', 'S', 'N', 'A', 'P', '0', '1' };
+static const size_t kHeaderBytes = 16;
+
+static uint64_t headerTermCount( const char* header )
+{
+  uint64_t termCount = 0;
+  for( size_t i = 0; i < 8; ++i )
+  {
+    termCount |= static_cast<uint64_t>( static_cast<unsigned char>( header[ sizeof( kMagic ) + i ] ) ) << ( i * 8 );
+  }
+  return termCount;
+}
+
+static void putHeader( FILE* pFile, const uint64_t termCount )
+{
+  char header[ kHeaderBytes ];
+  memcpy( header, kMagic, sizeof( kMagic ) );
+  for( size_t i = 0; i < 8; ++i )
+  {
+    header[ sizeof( kMagic ) + i ] = static_cast<char>( termCount >> ( i * 8 ) );
+  }
+  fwrite( header, 1, kHeaderBytes, pFile );
+}
+
+// a snapshot is written as path.partial and only renamed to path once it's complete, so a failed
+// write (or merge) never leaves something at path that reads as a good snapshot. it goes out with
+// a placeholder header, since the term count is only known at the end.
+static std::string partialPath( const char* path )
+{
+  return std::string( path ) + ".partial";
+}
+
+static FILE* startSnapshot( const char* path )
+{
+  FILE* pFile = fopen( partialPath( path ).c_str(), "wb" );
+  if( !pFile )
+  {
+    std::cerr << "error: can't write snapshot " << path << std::endl;
+    return 0;
+  }
+  putHeader( pFile, 0 );
+  return pFile;
+}
+
+static void abandonSnapshot( FILE* pFile, const char* path )
+{
+  fclose( pFile );
+  remove( partialPath( path ).c_str() );
+}
+
+static bool finishSnapshot( FILE* pFile, RunWriter& writer, const uint64_t termCount, const char* path )
+{
+  // finish() leaves the file rewound, right where the real header goes.
+  bool fOk = writer.finish();
+  putHeader( pFile, termCount );
+  fOk = !ferror( pFile ) && fOk;
+  fOk = fclose( pFile ) == 0 && fOk;
+  fOk = fOk && rename( partialPath( path ).c_str(), path ) == 0;
+  if( !fOk )
+  {
+    std::cerr << "error: can't write snapshot " << path << std::endl;
+    remove( partialPath( path ).c_str() );
+  }
+  return fOk;
+}
+
+bool writeSnapshot( const TermTable& terms, const char* path )
+{
+  std::vector<TermRef> sorted;
+  sortTerms( terms, sorted );
+
+  FILE* pFile = startSnapshot( path );
+  if( !pFile )
+    return false;
+  RunWriter writer( pFile );
+  for( std::vector<TermRef>::const_iterator it = sorted.begin(); it != sorted.end(); ++it )
+  {
+    writer.add( it->m_term, it->m_length, it->m_count );
+  }
+  return finishSnapshot( pFile, writer, sorted.size(), path );
+}
+
+bool mergeSnapshots( const std::vector<const char*>& paths, const unsigned k, const char* outPath, CompletionIndexBuilder* pIndex )
+{
+  std::vector<InputBuffer*> snapshots;
+  std::vector<RunReader>    readers;
+  std::vector<RunReader*>   pReaders;
+  readers.reserve( paths.size() );
+  bool fOk = true;
+  for( std::vector<const char*>::const_iterator it = paths.begin(); it != paths.end() && fOk; ++it )
+  {
+    InputBuffer* pSnapshot = InputBuffer::open( *it );
+    if( !pSnapshot )
+    {
+      std::cerr << "error: can't open snapshot " << *it << std::endl;
+      fOk = false;
+      break;
+    }
+    snapshots.push_back( pSnapshot );
+    if( static_cast<size_t>( pSnapshot->end() - pSnapshot->begin() ) < kHeaderBytes || memcmp( pSnapshot->begin(), kMagic, sizeof( kMagic ) ) != 0 )
+    {
+      std::cerr << "error: " << *it << " isn't a snapshot" << std::endl;
+      fOk = false;
+      break;
+    }
+    readers.push_back( RunReader( pSnapshot->begin() + kHeaderBytes, pSnapshot->end() ) );
+    pReaders.push_back( &readers.back() );
+  }
+
+  FILE* pOut = 0;
+  if( fOk && outPath )
+  {
+    pOut = startSnapshot( outPath );
+    fOk = pOut != 0;
+  }
+
+  if( fOk )
+  {
+    CopyingTopKSelector selector( k );
+    RunMerger merger( pReaders );
+    std::auto_ptr<RunWriter> pWriter( pOut ? new RunWriter( pOut ) : 0 );
+    uint64_t termCount = 0;
+    while( merger.next() )
+    {
+      const std::string& term = merger.term();
+      selector.offer( term.data(), term.length(), merger.count() );
+      if( pWriter.get() )
+        pWriter->add( term.data(), term.length(), merger.count() );
+      if( pIndex )
+        pIndex->add( term.data(), term.length(), merger.count() );
+      ++termCount;
+    }
+
+    // a run that's cut short reads as a shorter run, so only the header's term count tells: every
+    // snapshot must have been read to the end, record for record. the output only gets its real
+    // name once they all check out.
+    for( size_t i = 0; i < readers.size(); ++i )
+    {
+      if( readers[ i ].bad() || readers[ i ].records() != headerTermCount( snapshots[ i ]->begin() ) )
+      {
+        std::cerr << "error: " << paths[ i ] << " is truncated or corrupt" << std::endl;
+        fOk = false;
+      }
+    }
+    if( pWriter.get() )
+    {
+      if( fOk )
+        fOk = finishSnapshot( pOut, *pWriter, termCount, outPath );
+      else
+        abandonSnapshot( pOut, outPath );
+    }
+
+    if( fOk )
+    {
+      std::vector<TermRef> best;
+      selector.takeResults( best );
+      for( std::vector<TermRef>::const_iterator it = best.begin(); it != best.end(); ++it )
+      {
+        std::cout.write( it->m_term, it->m_length ) << '\n';
+      }
+      std::cout.flush();
+    }
+  }
+
+  for( std::vector<InputBuffer*>::const_iterator it = snapshots.begin(); it != snapshots.end(); ++it )
+  {
+    delete *it;
+  }
+  return fOk;
+}
@@ -0,0 +1,33 @@
+// term-snapshot.h: term counts saved to a file, to be combined with counts made elsewhere.
+//  "frequent-terms -snapshot <path>" writes the final counts of the default mode, and
+//  "frequent-terms -merge <k> <snapshot>..." prints the best k of the snapshots' summed counts.
+//  a snapshot is
+//      "FTSNAP01", the number of terms (8 bytes, little-endian), the terms as a run (term-runs.h)
+//  so it's sorted by term, prefix-compressed and varint-counted: usually a few bytes per term,
+//  a good deal smaller than the text it was counted from.
+//
+//  the merge maps each snapshot and streams them all through one RunMerger, which meets equal
+//  terms side by side and adds them up, into a CopyingTopKSelector. nothing is rebuilt in memory:
+//  it takes O(snapshots + k) memory whatever the number of distinct terms. with -snapshot too the
+//  merged counts are written out as another snapshot, so merges can be stacked. a snapshot whose
+//  records don't add up to its header's term count, or come out of order, fails the merge, and
+//  then no output snapshot is left behind: snapshots are written under a temporary name and only
+//  renamed into place when complete.
+#ifndef TERM_SNAPSHOT_H
+#define TERM_SNAPSHOT_H
+
+#include <vector>
+
+#include "term-table.h"
+
+class CompletionIndexBuilder;
+
+// false (after saying why) if the file can't be written.
+bool writeSnapshot( const TermTable& terms, const char* path );
+
+// prints the best k of the snapshots' summed counts, writes the sums to outPath unless it's 0 and
+// feeds them to pIndex unless it's 0. false (after saying why) if a snapshot can't be read or the
+// output can't be written.
+bool mergeSnapshots( const std::vector<const char*>& paths, const unsigned k, const char* outPath, CompletionIndexBuilder* pIndex );
+
+#endif // TERM_SNAPSHOT_H
@@ -0,0 +1,149 @@
+// term-table.cpp: open-addressing term table (see term-table.h)
+#include "term-table.h"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// TermKey
+
+// a term too long to inline hashes by its first kInlineBytes, which is fine for picking a shard
+// and unused otherwise.
+void TermKey::set( const char* _term, const size_t _length )
+{
+  m_term = _term;
+  m_length = _length;
+  m_fInline = _length <= kInlineBytes && !memchr( _term, 0, _length );
+  memset( m_padded, 0, kInlineBytes );
+  memcpy( m_padded, _term, std::min( _length, kInlineBytes ) );
+  m_hash = hashPadded( m_padded );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// TermTable
+
+// an overflow map node: the string's heap buffer plus the node, its hash and a bucket pointer.
+static size_t overflowEntryBytes( const size_t length )
+{
+  return length + 1 + 64;
+}
+
+TermTable::TermTable() : m_slots(), m_mask( 0 ), m_used( 0 ), m_overflow(), m_overflowBytes( 0 )
+{
+  rehash( 64 );
+}
+
+// linear probing: returns the slot holding the key, or the empty slot where it belongs.
+TermTable::Slot& TermTable::probe( const char* paddedKey, const uint32_t hash )
+{
+  size_t i = hash & m_mask;
+  for( ;; )
+  {
+    Slot& slot = m_slots[ i ];
+    if( slot.m_count == 0 || memcmp( slot.m_key, paddedKey, kInlineKeyBytes ) == 0 )
+      return slot;
+    i = ( i + 1 ) & m_mask;
+  }
+}
+
+void TermTable::rehash( const size_t slotCount )
+{
+  std::vector<Slot> old( slotCount );
+  old.swap( m_slots );
+  m_mask = slotCount - 1;
+  for( std::vector<Slot>::const_iterator it = old.begin(); it != old.end(); ++it )
+  {
+    if( it->m_count > 0 )
+      probe( it->m_key, TermKey::hashPadded( it->m_key ) ) = *it;
+  }
+}
+
+void TermTable::reserve( const size_t termCount )
+{
+  size_t slotCount = m_slots.size();
+  while( slotCount < termCount * 2 )
+    slotCount *= 2;
+  if( slotCount != m_slots.size() )
+    rehash( slotCount );
+}
+
+void TermTable::add( const TermKey& key, const uint64_t count )
+{
+  if( !key.fitsInline() )
+  {
+    const std::pair<OverflowMap::iterator, bool> inserted = m_overflow.insert( OverflowMap::value_type( std::string( key.m_term, key.m_length ), 0 ) );
+    inserted.first->second += count;
+    if( inserted.second )
+      m_overflowBytes += overflowEntryBytes( key.m_length );
+    return;
+  }
+
+  Slot* pSlot = &probe( key.m_padded, key.m_hash );
+  if( pSlot->m_count > 0 )
+  {
+    pSlot->m_count += count;
+    return;
+  }
+
+  // new term. keep the table at most half full so probe runs stay short.
+  if( ( m_used + 1 ) * 2 > m_slots.size() )
+  {
+    rehash( m_slots.size() * 2 );
+    pSlot = &probe( key.m_padded, key.m_hash );
+  }
+  memcpy( pSlot->m_key, key.m_padded, kInlineKeyBytes );
+  pSlot->m_count = count;
+  ++m_used;
+}
+
+void TermTable::merge( const TermTable& other )
+{
+  reserve( std::max( size(), other.size() ) );
+  for( std::vector<Slot>::const_iterator it = other.m_slots.begin(); it != other.m_slots.end(); ++it )
+  {
+    if( it->m_count == 0 )
+      continue;
+    // already padded, skip straight to the probe.
+    const uint32_t hash = TermKey::hashPadded( it->m_key );
+    Slot* pSlot = &probe( it->m_key, hash );
+    if( pSlot->m_count == 0 )
+    {
+      if( ( m_used + 1 ) * 2 > m_slots.size() )
+      {
+        rehash( m_slots.size() * 2 );
+        pSlot = &probe( it->m_key, hash );
+      }
+      *pSlot = *it;
+      ++m_used;
+    }
+    else
+      pSlot->m_count += it->m_count;
+  }
+  for( OverflowMap::const_iterator it = other.m_overflow.begin(); it != other.m_overflow.end(); ++it )
+  {
+    const std::pair<OverflowMap::iterator, bool> inserted = m_overflow.insert( OverflowMap::value_type( it->first, 0 ) );
+    inserted.first->second += it->second;
+    if( inserted.second )
+      m_overflowBytes += overflowEntryBytes( it->first.length() );
+  }
+}
+
+void TermTable::swap( TermTable& other )
+{
+  m_slots.swap( other.m_slots );
+  std::swap( m_mask, other.m_mask );
+  std::swap( m_used, other.m_used );
+  m_overflow.swap( other.m_overflow );
+  std::swap( m_overflowBytes, other.m_overflowBytes );
+}
+
+void TermTable::clear( void )
+{
+  for( std::vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it )
+  {
+    it->m_count = 0;
+  }
+  m_used = 0;
+  OverflowMap().swap( m_overflow );
+  m_overflowBytes = 0;
+}
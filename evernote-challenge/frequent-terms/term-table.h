@@ -0,0 +1,120 @@
+// term-table.h: flat open-addressing hash table from term to count, for frequent-terms.
+//  terms are short (the spec says under 25 chars), so each slot holds its key inline, zero-padded
+//  to a fixed width. a lookup is one hash, then usually one slot and one fixed-size memcmp: no
+//  pointer chasing, no string compares along a tree path and no allocation per term. the odd
+//  term too long to inline, or with a '\0' in it (so strlen can't recover its length from the
+//  padding), goes to an ordinary overflow map instead. counts are 64-bit all the way through, so
+//  they don't wrap however big the input gets.
+#ifndef TERM_TABLE_H
+#define TERM_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstring>  // memcmp, memcpy, memset
+#include <stdint.h>
+
+// a term ready for lookup: zero-padded to the slot width and hashed. built once per term, so
+// callers that need the hash too (to pick a shard, say) don't pay for it twice. m_term is a view,
+// it's only good as long as whatever it points into.
+struct TermKey
+{
+  static const size_t kInlineBytes = 24;
+
+  char        m_padded[ kInlineBytes ];  // first kInlineBytes of the term, zero-padded
+  uint32_t    m_hash;
+  bool        m_fInline;  // short enough for a slot and free of '\0'
+  const char* m_term;
+  size_t      m_length;
+
+  TermKey() : m_hash( 0 ), m_fInline( true ), m_term( 0 ), m_length( 0 ) {}
+  TermKey( const char* _term, const size_t _length ) { set( _term, _length ); }
+
+  void set( const char* _term, const size_t _length );
+
+  bool fitsInline( void ) const { return m_fInline; }
+
+  // the hash of a full-width padded key, for code that fills m_padded itself.
+  static uint32_t hashPadded( const char* padded )
+  {
+    uint64_t words[ 3 ];
+    memcpy( words, padded, sizeof( words ) );
+    uint64_t h = words[ 0 ] * 0x9E3779B97F4A7C15ull;
+    h = ( h ^ ( h >> 32 ) ^ words[ 1 ] ) * 0xC2B2AE3D27D4EB4Full;
+    h = ( h ^ ( h >> 29 ) ^ words[ 2 ] ) * 0x165667B19E3779F9ull;
+    return static_cast<uint32_t>( h ^ ( h >> 32 ) );
+  }
+};
+
+class TermTable
+{
+public:
+  static const size_t kInlineKeyBytes = TermKey::kInlineBytes;
+
+private:
+  // two slots per cache line. there's no room left for the hash next to a 64-bit count, so probes
+  // compare the (fixed-width) keys directly and a rehash hashes them again.
+  struct alignas( 32 ) Slot
+  {
+    char     m_key[ kInlineKeyBytes ];  // zero-padded
+    uint64_t m_count;  // 0 == empty slot
+  };
+
+  typedef std::unordered_map<std::string, uint64_t> OverflowMap;
+
+  std::vector<Slot> m_slots;  // size is a power of two, at most half full
+  size_t            m_mask;
+  size_t            m_used;
+  OverflowMap       m_overflow;  // terms that don't fit inline (TermKey::fitsInline)
+  size_t            m_overflowBytes;  // rough heap use of m_overflow
+
+  static size_t keyLength( const Slot& slot ) { return slot.m_key[ kInlineKeyBytes - 1 ] ? kInlineKeyBytes : strlen( slot.m_key ); }
+
+  Slot& probe( const char* paddedKey, const uint32_t hash );
+  void  rehash( const size_t slotCount );
+
+public:
+  TermTable();
+
+  // sizes the table for termCount distinct terms up front.
+  void reserve( const size_t termCount );
+
+  void add( const TermKey& key, const uint64_t count );
+  void increment( const char* term, const size_t length ) { add( TermKey( term, length ), 1 ); }
+
+  // adds every count in other to this table.
+  void merge( const TermTable& other );
+
+  void swap( TermTable& other );
+
+  // forgets every term but keeps the slots, so refilling doesn't regrow the table.
+  void clear( void );
+
+  // number of distinct terms.
+  size_t size( void ) const { return m_used + m_overflow.size(); }
+
+  // the slots held now can take this many terms before the table grows (to twice the slots).
+  size_t capacity( void ) const { return m_slots.size() / 2; }
+
+  // bytes held, roughly: the slots plus the overflow map's nodes and strings.
+  size_t memoryUsage( void ) const { return m_slots.size() * sizeof( Slot ) + m_overflowBytes; }
+
+  static size_t slotBytes( void ) { return sizeof( Slot ); }
+
+  // calls f( term, length, count ) once per distinct term, in no particular order.
+  template<typename F>
+  void forEach( F& f ) const
+  {
+    for( std::vector<Slot>::const_iterator it = m_slots.begin(); it != m_slots.end(); ++it )
+    {
+      if( it->m_count > 0 )
+        f( it->m_key, keyLength( *it ), it->m_count );
+    }
+    for( OverflowMap::const_iterator it = m_overflow.begin(); it != m_overflow.end(); ++it )
+    {
+      f( it->first.data(), it->first.length(), it->second );
+    }
+  }
+};
+
+#endif // TERM_TABLE_H
@@ -0,0 +1,96 @@
+// text-ingest.cpp: splitting free text into counted words (see text-ingest.h)
+#include "text-ingest.h"
+
+#include <algorithm>
+
+#include "input-buffer.h"
+#include "term-normalize.h"
+#include "term-table.h"
+
+// ASCII punctuation: !"#$%&'()*+,-./ :;<=>?@ [\]^_` {|}~
+static bool isAsciiPunct( const char c )
+{
+  return ( c >= '!' && c <= '/' ) || ( c >= ':' && c <= '@' ) || ( c >= '[' && c <= '`' ) || ( c >= '{' && c <= '~' );
+}
+
+// the first position at or after from whose bit is fSet, or the end of the bitmap.
+static size_t nextBit( const std::vector<uint32_t>& bits, const size_t from, const bool fSet )
+{
+  const size_t limit = bits.size() * 32;
+  if( from >= limit )
+    return limit;
+  size_t w = from / 32;
+  uint32_t word = ( fSet ? bits[ w ] : ~bits[ w ] ) & ( ~0u << ( from % 32 ) );
+  while( word == 0 )
+  {
+    if( ++w == bits.size() )
+      return limit;
+    word = fSet ? bits[ w ] : ~bits[ w ];
+  }
+  return w * 32 + __builtin_ctz( word );
+}
+
+TextTokenizer::TextTokenizer( const bool _fFold, const bool _fStrip ) :
+  m_fFold( _fFold ),
+  m_fStrip( _fStrip ),
+  m_spaceBits(),
+  m_folded()
+{
+}
+
+void TextTokenizer::countWord( const char* begin, const char* end, TermCounter& counter ) const
+{
+  if( m_fStrip )
+  {
+    while( begin != end && isAsciiPunct( *begin ) )
+      ++begin;
+    while( end != begin && isAsciiPunct( end[ -1 ] ) )
+      --end;
+    if( begin == end )
+      return;
+  }
+  counter.handle( TermKey( begin, end - begin ) );
+}
+
+void TextTokenizer::countLine( const char* begin, const char* end, TermCounter& counter )
+{
+  markTermSpace( begin, end, m_spaceBits );
+
+  // folding doesn't move whitespace, so the bitmap holds for the folded copy too.
+  const char* text = begin;
+  if( m_fFold )
+  {
+    m_folded.resize( end - begin );
+    for( size_t i = 0; i < m_folded.size(); ++i )
+    {
+      const char c = begin[ i ];
+      m_folded[ i ] = static_cast<unsigned char>( c - 'A' ) < 26 ? c + ( 'a' - 'A' ) : c;
+    }
+    text = m_folded.empty() ? begin : &m_folded[ 0 ];
+  }
+
+  const size_t length = end - begin;
+  size_t pos = 0;
+  for( ;; )
+  {
+    const size_t wordBegin = nextBit( m_spaceBits, pos, false );
+    if( wordBegin >= length )
+      break;
+    // the bits past the line are set, so a word always ends by the end of the line.
+    const size_t wordEnd = std::min( nextBit( m_spaceBits, wordBegin, true ), length );
+    countWord( text + wordBegin, text + wordEnd, counter );
+    pos = wordEnd;
+  }
+}
+
+void countText( std::istream& input, TextTokenizer& tokenizer, TermCounter& counter )
+{
+  // LineStream leaves kReadPadding readable bytes past every line, what markTermSpace needs.
+  LineStream lines( input );
+  const char* begin;
+  const char* end;
+  while( lines.getLine( begin, end ) )
+  {
+    tokenizer.countLine( begin, end, counter );
+  }
+}
@@ -0,0 +1,41 @@
+// text-ingest.h: "frequent-terms -text <k>" counts the words of free text instead of one term per
+//  line, then shows the k most frequent. there's no N or k lines in this input, it's all text.
+//
+//  a word is a run of bytes other than whitespace. each line's whitespace is found a 32-byte
+//  block at a time by the term-normalize kernels (AVX2 or SSE2 where the cpu has it), and the
+//  words come off the resulting bitmap with a count-trailing-zeros per boundary, so nothing looks
+//  at the bytes one by one except to build each word's key. words are keyed and counted right
+//  where they sit in the read buffer, no std::string per word.
+//
+//  "-fold" lowercases ASCII letters (a line is folded into a scratch copy first, a loop the
+//  compiler vectorizes). "-strip" drops ASCII punctuation from both ends of a word, so "end." and
+//  "(end" both count as "end" but "don't" stays whole; a word that's all punctuation goes away.
+#ifndef TEXT_INGEST_H
+#define TEXT_INGEST_H
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+#include "term-counter.h"
+
+class TextTokenizer
+{
+  const bool            m_fFold;
+  const bool            m_fStrip;
+  std::vector<uint32_t> m_spaceBits;
+  std::vector<char>     m_folded;
+
+  void countWord( const char* begin, const char* end, TermCounter& counter ) const;
+
+public:
+  TextTokenizer( const bool _fFold, const bool _fStrip );
+
+  // counts every word of the line. may read up to 31 bytes past end.
+  void countLine( const char* begin, const char* end, TermCounter& counter );
+};
+
+// counts every word of the input.
+void countText( std::istream& input, TextTokenizer& tokenizer, TermCounter& counter );
+
+#endif // TEXT_INGEST_H
@@ -0,0 +1,135 @@
+// top-k-selector.cpp: heap / nth_element top-k selection (see top-k-selector.h)
+#include "top-k-selector.h"
+
+TopKSelector::TopKSelector( const size_t _k, const size_t termCount ) :
+  m_k( _k ),
+  // the heap wins while k is well under n; the 1/8 cutover is rough but neither side is sensitive to it.
+  m_fUseHeap( _k < termCount / 8 ),
+  m_terms()
+{
+  m_terms.reserve( m_fUseHeap ? m_k : termCount );
+}
+
+void TopKSelector::offer( const TermRef& term )
+{
+  if( m_k == 0 )
+    return;
+  if( !m_fUseHeap || m_terms.size() < m_k )
+  {
+    m_terms.push_back( term );
+    if( m_fUseHeap )
+      std::push_heap( m_terms.begin(), m_terms.end(), TermRankCompare() );
+    return;
+  }
+
+  // cheap reject first: nearly everything offered has a lower count than the worst kept term.
+  const TermRef& worst = m_terms.front();
+  if( term.m_count < worst.m_count || !TermRankCompare()( term, worst ) )
+    return;
+  std::pop_heap( m_terms.begin(), m_terms.end(), TermRankCompare() );
+  m_terms.back() = term;
+  std::push_heap( m_terms.begin(), m_terms.end(), TermRankCompare() );
+}
+
+void TopKSelector::takeResults( /*out*/ std::vector<TermRef>& results )
+{
+  results.clear();
+  results.swap( m_terms );
+  if( m_fUseHeap )
+  {
+    std::sort_heap( results.begin(), results.end(), TermRankCompare() );
+    return;
+  }
+
+  if( results.size() > m_k )
+  {
+    std::nth_element( results.begin(), results.begin() + m_k, results.end(), TermRankCompare() );
+    results.resize( m_k );
+  }
+  std::sort( results.begin(), results.end(), TermRankCompare() );
+}
+
+
+///////////////
+
+bool CopyingTopKSelector::better( const Kept& lhs, const Kept& rhs )
+{
+  return TermRankCompare()( TermRef( lhs.m_term.data(), lhs.m_term.length(), lhs.m_count ),
+                            TermRef( rhs.m_term.data(), rhs.m_term.length(), rhs.m_count ) );
+}
+
+// what a kept term allocated beyond its slot, allocator overhead included: nothing if it fits in
+// the string itself.
+size_t CopyingTopKSelector::termBytes( const std::string& term )
+{
+  static const size_t kShortCapacity = std::string().capacity();
+  return term.capacity() > kShortCapacity ? term.capacity() + 1 + 2 * sizeof( void* ) : 0;
+}
+
+CopyingTopKSelector::CopyingTopKSelector( const size_t _k, const size_t _maxBytes ) :
+  m_k( _k ),
+  m_maxBytes( _maxBytes ),
+  m_bytes( 0 ),
+  m_fOverBudget( false ),
+  m_heap()
+{
+}
+
+void CopyingTopKSelector::giveUp( void )
+{
+  std::vector<Kept>().swap( m_heap );
+  m_bytes = 0;
+  m_fOverBudget = true;
+}
+
+void CopyingTopKSelector::offer( const char* term, const size_t length, const uint64_t count )
+{
+  if( m_k == 0 || m_fOverBudget )
+    return;
+  if( m_heap.size() < m_k )
+  {
+    // grow the heap by hand, so it's charged before it's allocated. for a moment the old slots
+    // and the new ones are both there.
+    if( m_heap.size() == m_heap.capacity() )
+    {
+      const size_t capacity = std::min( m_k, std::max<size_t>( 16, m_heap.capacity() * 2 ) );
+      if( m_bytes + capacity * sizeof( Kept ) > m_maxBytes )
+      {
+        giveUp();
+        return;
+      }
+      m_bytes += ( capacity - m_heap.capacity() ) * sizeof( Kept );
+      m_heap.reserve( capacity );
+    }
+    const Kept kept = { std::string( term, length ), count };
+    m_heap.push_back( kept );
+    m_bytes += termBytes( m_heap.back().m_term );
+    std::push_heap( m_heap.begin(), m_heap.end(), better );
+    if( m_bytes > m_maxBytes )
+      giveUp();
+    return;
+  }
+
+  // cheap reject first, as in TopKSelector, and before any copy.
+  const Kept& worst = m_heap.front();
+  if( count < worst.m_count || !TermRankCompare()( TermRef( term, length, count ), TermRef( worst.m_term.data(), worst.m_term.length(), worst.m_count ) ) )
+    return;
+  std::pop_heap( m_heap.begin(), m_heap.end(), better );
+  m_bytes -= termBytes( m_heap.back().m_term );
+  m_heap.back().m_term.assign( term, length );
+  m_heap.back().m_count = count;
+  m_bytes += termBytes( m_heap.back().m_term );
+  std::push_heap( m_heap.begin(), m_heap.end(), better );
+  if( m_bytes > m_maxBytes )
+    giveUp();
+}
+
+void CopyingTopKSelector::takeResults( /*out*/ std::vector<TermRef>& results )
+{
+  std::sort_heap( m_heap.begin(), m_heap.end(), better );
+  results.clear();
+  for( std::vector<Kept>::const_iterator it = m_heap.begin(); it != m_heap.end(); ++it )
+  {
+    results.push_back( TermRef( it->m_term.data(), it->m_term.length(), it->m_count ) );
+  }
+}
@@ -0,0 +1,108 @@
+// top-k-selector.h: pick the k most frequent of a stream of (term, count) pairs, in output order
+//  (count descending, ties in lexicographical order).
+//
+//  the terms are referenced, not copied, so whatever they point into must outlive the selector.
+//  for k small next to the number of terms, keeps a k-sized heap with the worst kept term on top
+//  (O(n log k) time, O(k) memory; most terms lose to the top of the heap on count alone). once k
+//  is a good fraction of n the heap stops paying for itself and it just collects everything and
+//  uses nth_element plus a sort of the first k.
+#ifndef TOP_K_SELECTOR_H
+#define TOP_K_SELECTOR_H
+
+#include <string>
+#include <vector>
+#include <cstring>  // memcmp
+#include <algorithm>
+#include <stdint.h>
+
+struct TermRef
+{
+  const char* m_term;
+  size_t      m_length;
+  uint64_t    m_count;  // wide for counts summed across runs (term-runs.h); costs no space here
+
+  TermRef() : m_term( 0 ), m_length( 0 ), m_count( 0 ) {}
+  TermRef( const char* _term, const size_t _length, const uint64_t _count ) : m_term( _term ), m_length( _length ), m_count( _count ) {}
+};
+
+// strict weak ordering, true if lhs comes out before rhs.
+struct TermRankCompare
+{
+  bool operator()( const TermRef& lhs, const TermRef& rhs ) const
+  {
+    if( lhs.m_count != rhs.m_count )
+      return lhs.m_count > rhs.m_count;
+    const int prefix = memcmp( lhs.m_term, rhs.m_term, std::min( lhs.m_length, rhs.m_length ) );
+    return prefix != 0 ? prefix < 0 : lhs.m_length < rhs.m_length;
+  }
+};
+
+// strict weak ordering on the terms alone, bytewise (the order of sorted runs and snapshots).
+struct TermOrderCompare
+{
+  bool operator()( const TermRef& lhs, const TermRef& rhs ) const
+  {
+    const int prefix = memcmp( lhs.m_term, rhs.m_term, std::min( lhs.m_length, rhs.m_length ) );
+    return prefix != 0 ? prefix < 0 : lhs.m_length < rhs.m_length;
+  }
+};
+
+class TopKSelector
+{
+  const size_t         m_k;
+  const bool           m_fUseHeap;
+  std::vector<TermRef> m_terms;  // heap mode: a heap of the best k so far, worst on top
+
+public:
+  // termCount is how many terms will be offered (an estimate is fine), it picks the strategy.
+  TopKSelector( const size_t _k, const size_t termCount );
+
+  void offer( const TermRef& term );
+
+  // so a selector can be handed straight to TermTable::forEach.
+  void operator()( const char* term, const size_t length, const uint64_t count ) { offer( TermRef( term, length, count ) ); }
+
+  // the best min( k, terms offered ), best first. leaves the selector empty.
+  void takeResults( /*out*/ std::vector<TermRef>& results );
+};
+
+///////////////
+
+// the heap strategy for terms that don't stay put, like the output of a streaming merge: the terms
+// it keeps are copied. a term is only copied if it makes the cut, so memory is O(k). that can
+// still be a lot for a big k, so it can be capped: see overBudget().
+class CopyingTopKSelector
+{
+  struct Kept
+  {
+    std::string m_term;
+    uint64_t    m_count;
+  };
+
+  static bool better( const Kept& lhs, const Kept& rhs );
+  static size_t termBytes( const std::string& term );
+
+  const size_t      m_k;
+  const size_t      m_maxBytes;
+  size_t            m_bytes;        // the heap's slots plus what the kept terms allocated
+  bool              m_fOverBudget;
+  std::vector<Kept> m_heap;         // worst kept term on top
+
+  void giveUp( void );
+
+public:
+  CopyingTopKSelector( const size_t _k, const size_t _maxBytes = static_cast<size_t>( -1 ) );
+
+  // true once keeping the best k took more than maxBytes. the selector has then let go of what it
+  // kept and ignores any more offers, so the caller has to rank some other way.
+  bool overBudget( void ) const { return m_fOverBudget; }
+
+  void offer( const char* term, const size_t length, const uint64_t count );
+  void operator()( const char* term, const size_t length, const uint64_t count ) { offer( term, length, count ); }
+
+  // the best min( k, terms offered ), best first. they point into the selector, so they're good
+  // until it's destroyed; offer nothing more after this.
+  void takeResults( /*out*/ std::vector<TermRef>& results );
+};
+
+#endif // TOP_K_SELECTOR_H
@@ -6,11 +6,72 @@
 #include <algorithm>
 #include <memory>
 #include <climits> // LONG_MIN
+#include <cstdlib> // strtol
 #include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// TopNBuffer
+// TopNBuffer and related
+
+// both buffers keep the N largest of the values they're handed. until N values have come in, the
+// missing ones show as LONG_MIN. there's no common base: the command loop is a template over the
+// buffer type, so handle() is a direct call the compiler can inline.
+
+// N fixed at compile time, for the small N this is used with. the values live in a plain array
+// the compiler can keep in registers. nearly every value is below the smallest kept one once the
+// buffer has filled, and that's one compare. a value that gets in replaces the smallest, then one
+// pass of compare-exchanges (min / max, so cmovs rather than branches) walks it up to its place.
+template<unsigned K>
 class TopNBuffer
+{
+  long int m_buf[ K ];  // descending, zero'th element is largest
+  unsigned m_entriesRemaining;
+
+public:
+  TopNBuffer() : m_entriesRemaining( 0 )
+  {
+    std::fill( m_buf, m_buf + K, LONG_MIN );
+  }
+
+  void handle( const long int newValue )
+  {
+    if( m_entriesRemaining == 0 )
+    {
+      return;
+    }
+    m_entriesRemaining--;
+
+    if( newValue < m_buf[ K - 1 ] )
+    {
+      return;
+    }
+    m_buf[ K - 1 ] = newValue;
+    for( unsigned i = K - 1; i > 0; --i )
+    {
+      const long int above = m_buf[ i - 1 ];
+      const long int here = m_buf[ i ];
+      m_buf[ i - 1 ] = std::max( above, here );
+      m_buf[ i ] = std::min( above, here );
+    }
+  }
+
+  void setEntriesRemaining( const unsigned remaining )
+  {
+    m_entriesRemaining = remaining;
+  }
+
+  void showResults( void )
+  {
+    for( unsigned i = 0; i < K; ++i )
+    {
+      std::cout << m_buf[ i ] << std::endl;
+    }
+  }
+};
+
+///////////////
+
+// N chosen at run time, for any N the template isn't instantiated for.
+class RuntimeTopNBuffer
 {
   std::vector<long int> m_buf;  // descending, zero'th element is largest
   const unsigned m_bufSize;
@@ -19,7 +80,7 @@ class TopNBuffer
   static void insertValue( const long int newValue, std::vector<long int>::iterator it, std::vector<long int>::iterator end );
 
 public:
-  TopNBuffer( const unsigned bufSize ) : m_bufSize( bufSize ), m_buf( bufSize, LONG_MIN ), m_entriesRemaining( 0 )
+  RuntimeTopNBuffer( const unsigned bufSize ) : m_bufSize( bufSize ), m_buf( bufSize, LONG_MIN ), m_entriesRemaining( 0 )
   {
   }
 
@@ -29,7 +90,7 @@ public:
   
 };
 
-/*static*/ void TopNBuffer::insertValue( const long int newValue, std::vector<long int>::iterator it, std::vector<long int>::iterator end )
+/*static*/ void RuntimeTopNBuffer::insertValue( const long int newValue, std::vector<long int>::iterator it, std::vector<long int>::iterator end )
 {
   const long int oldValue = *it;
   *it = newValue;
@@ -39,7 +100,7 @@ public:
   }
 }
 
-void TopNBuffer::handle( const long int newValue )
+void RuntimeTopNBuffer::handle( const long int newValue )
 {
   if( m_entriesRemaining == 0 )
   {
@@ -57,12 +118,12 @@ void TopNBuffer::handle( const long int newValue )
   }
 }
 
-void TopNBuffer::setEntriesRemaining( const unsigned remaining )
+void RuntimeTopNBuffer::setEntriesRemaining( const unsigned remaining )
 {
   m_entriesRemaining = remaining;
 }
 
-void TopNBuffer::showResults( void )
+void RuntimeTopNBuffer::showResults( void )
 {
   for( std::vector<long int>::const_iterator it = m_buf.begin(); it != m_buf.end(); ++it )
   {
@@ -74,74 +135,73 @@ void TopNBuffer::showResults( void )
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Commands
 
+template<typename Buffer>
 class Command
 {
 public:
-  virtual void perform( TopNBuffer& buf ) const = 0;
+  virtual ~Command() {}
+  virtual void perform( Buffer& buf ) const = 0;
 };
 
 ///////////////
 
-class SizeCommand : public Command
+template<typename Buffer>
+class SizeCommand : public Command<Buffer>
 {
   const unsigned m_size;
 public:
   SizeCommand( const unsigned _size ) : m_size( _size ) {}
-  void perform( TopNBuffer& buf ) const;
+  void perform( Buffer& cb ) const
+  {
+    cb.setEntriesRemaining( m_size );
+  }
 };
 
-void SizeCommand::perform( TopNBuffer& cb ) const
-{
-  cb.setEntriesRemaining( m_size );
-}
-
 ///////////////
 
-class NewEntryCommand : public Command
+template<typename Buffer>
+class NewEntryCommand : public Command<Buffer>
 {
   const long int m_entryValue;
 public:
   NewEntryCommand( const long int entryValue ) : m_entryValue( entryValue ) {}
-  void perform( TopNBuffer& buf ) const;
+  void perform( Buffer& buf ) const
+  {
+    buf.handle( m_entryValue );
+  }
 };
 
-void NewEntryCommand::perform( TopNBuffer& buf ) const
-{
-  buf.handle( m_entryValue );
-}
-
 ///////////////
 
-class QuitCommand : public Command
+template<typename Buffer>
+class QuitCommand : public Command<Buffer>
 {
 public:
   QuitCommand() {}
-  void perform( TopNBuffer& buf ) const;
+  void perform( Buffer& buf ) const
+  {
+    // do nothing
+  }
 };
 
-void QuitCommand::perform( TopNBuffer& buf ) const
-{
-  // do nothing
-}
-
 ///////////////
 
-class CommandError : public Command
+template<typename Buffer>
+class CommandError : public Command<Buffer>
 {
 public:
   CommandError() {}
-  void perform( TopNBuffer& buf ) const;
+  void perform( Buffer& buf ) const
+  {
+    // do nothing
+  }
 };
 
-void CommandError::perform( TopNBuffer& buf ) const
-{
-  // do nothing
-}
-
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // InputParser
 
+template<typename Buffer>
 class InputParser
 {
   bool            m_didReadSize;
@@ -153,47 +213,91 @@ public:
     m_didReadSize( false )
   { }
 
-  std::auto_ptr<const Command> getNextCommand( /*out*/ bool& fDone );
-};
+  std::auto_ptr<const Command<Buffer> > getNextCommand( /*out*/ bool& fDone )
+  {
+    fDone = false;
 
-std::auto_ptr<const Command> InputParser::getNextCommand( /*out*/ bool& fDone )
-{
-  fDone = false;
+    std::string thisLine;
+    if( !std::getline( m_istream, thisLine ) )
+    {
+      fDone = true;
+      return std::auto_ptr<const Command<Buffer> >( new QuitCommand<Buffer>() );
+    }
 
-  std::string thisLine;
-  if( !std::getline( m_istream, thisLine ) )
-  {
-    fDone = true;
-    return std::auto_ptr<const Command>( new QuitCommand() );
-  }
+    if( !m_didReadSize )
+    {
+      const unsigned size = atoi( thisLine.c_str() );
+      m_didReadSize = true;
+      return std::auto_ptr<const Command<Buffer> >( new SizeCommand<Buffer>( size ) );
+    }
 
-  if( !m_didReadSize )
-  {
-    const unsigned size = atoi( thisLine.c_str() );
-    m_didReadSize = true;
-    return std::auto_ptr<const Command>( new SizeCommand( size ) );
+    const long int newEntry = atol( thisLine.c_str() );
+    return std::auto_ptr<const Command<Buffer> >( new NewEntryCommand<Buffer>( newEntry ) );
   }
-
-  const long int newEntry = atol( thisLine.c_str() );
-  return std::auto_ptr<const Command>( new NewEntryCommand( newEntry ) );
-}
+};
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // main
 
-int main( int argc, char **argv )
+// instantiated per buffer type, so each command's perform() calls that buffer's handle() directly.
+template<typename Buffer>
+static void runCommands( std::istream& input, Buffer& buf )
 {
-  InputParser ip( std::cin );
-  TopNBuffer buf( 4 );
+  InputParser<Buffer> ip( input );
 
   bool fDone( false );
   while( !fDone )
   {
-    std::auto_ptr<const Command> pCmd = ip.getNextCommand( fDone );
+    std::auto_ptr<const Command<Buffer> > pCmd = ip.getNextCommand( fDone );
     pCmd->perform( buf );
   }
   buf.showResults();
+}
+
+template<unsigned K>
+static void runFixed( std::istream& input )
+{
+  TopNBuffer<K> buf;
+  runCommands( input, buf );
+}
+
+// more than this and the buffer is the problem, not the input.
+static const long int kMaxBufSize = 1 << 20;
+
+int main( int argc, char **argv )
+{
+  // "top-four <n>" keeps the top n instead.
+  long int bufSize = 4;
+  if( argc > 1 )
+  {
+    char* end;
+    bufSize = strtol( argv[ 1 ], &end, 10 );
+    if( end == argv[ 1 ] || *end != '\0' || bufSize <= 0 || bufSize > kMaxBufSize )
+    {
+      std::cerr << "usage: top-four [count], count from 1 to " << kMaxBufSize << std::endl;
+      return 1;
+    }
+  }
+
+  // the fixed-size buffer for the usual small n, else the run time one.
+  switch( bufSize )
+  {
+    case 1: runFixed<1>( std::cin ); break;
+    case 2: runFixed<2>( std::cin ); break;
+    case 3: runFixed<3>( std::cin ); break;
+    case 4: runFixed<4>( std::cin ); break;
+    case 5: runFixed<5>( std::cin ); break;
+    case 6: runFixed<6>( std::cin ); break;
+    case 7: runFixed<7>( std::cin ); break;
+    case 8: runFixed<8>( std::cin ); break;
+    default:
+    {
+      RuntimeTopNBuffer buf( bufSize );
+      runCommands( std::cin, buf );
+      break;
+    }
+  }
 
   return 0;
 }